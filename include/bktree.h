@@ -0,0 +1,65 @@
+#ifndef SPELLCHECKER_BKTREE_H
+#define SPELLCHECKER_BKTREE_H
+
+#include <dictionary.h>
+#include <spellchecker.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/// @brief Burkhard-Keller tree over a list of words, using the levenshtein
+/// distance as the metric. The triangle inequality lets a query skip every
+/// subtree whose edge distance is too far from its own distance to the node,
+/// so lookups are exact while touching a small part of the dictionary. Nodes
+/// and edges are stored in flat arrays in breadth-first order
+class BKTree {
+public:
+    /// @brief Builds the tree. Takes O(n log n) distance calculations on
+    /// typical dictionaries
+    /// @param words list of unique words to index
+    explicit BKTree(const Dictionary& words);
+
+    /// @brief Finds all words within a given distance of the query
+    /// @param query word to look up
+    /// @param maxDist largest distance a result may have
+    /// @return matching words, ordered by distance to the query
+    std::vector<Suggestion> search(const std::string& query,
+                                   int maxDist) const;
+
+    /// @brief Finds the k words closest to the query
+    /// @param query word to look up
+    /// @param k number of words to return
+    /// @param maxDist largest distance a result may have
+    /// @return up to k words, ordered by distance to the query
+    std::vector<Suggestion> nearest(
+        const std::string& query, std::size_t k,
+        int maxDist = std::numeric_limits<int>::max()) const;
+
+    /// @return number of words in the tree
+    std::size_t size() const { return nodes.size(); }
+
+private:
+    // node i holds words[i]
+    struct Node {
+        std::uint32_t firstEdge;
+        std::uint32_t edgeCount;
+    };
+
+    // edges of a node are sorted by distance, so the range of children that
+    // may contain a match is found with a binary search
+    struct Edge {
+        int distance;
+        std::uint32_t child;
+    };
+
+    Dictionary words;
+    std::vector<Node> nodes;
+
+    // position of every node's word in the original word list
+    std::vector<std::uint32_t> ranks;
+    std::vector<Edge> edges;
+};
+
+#endif
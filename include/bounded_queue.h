@@ -0,0 +1,153 @@
+#ifndef SPELLCHECKER_BOUNDED_QUEUE_H
+#define SPELLCHECKER_BOUNDED_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+/// @brief Lock-free queue of fixed capacity for any number of producers and
+/// consumers (Vyukov's bounded MPMC queue). Every cell carries a sequence
+/// number telling whether it is ready to be written or read in the current
+/// lap, so a push or a pop costs one compare-and-swap on the shared position
+/// and touches no lock. push and pop wait by yielding and then sleeping
+/// briefly, the queue is meant for items that take far longer to produce or
+/// consume than a wakeup, such as chunks of a file
+/// @tparam T type of the items, has to be default constructible and movable
+template <typename T>
+class BoundedQueue {
+public:
+    /// @param capacity largest number of queued items, rounded up to a power
+    /// of two
+    explicit BoundedQueue(std::size_t capacity) {
+        std::size_t size = 2;
+
+        while (size < capacity) {
+            size *= 2;
+        }
+
+        cells = std::make_unique<Cell[]>(size);
+        mask = size - 1;
+
+        for (std::size_t i = 0; i < size; i++) {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    BoundedQueue(const BoundedQueue&) = delete;
+    BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+    /// @brief Queues an item unless the queue is full
+    /// @param item item to queue, moved from on success
+    /// @return whether the item was queued
+    bool tryPush(T& item) {
+        std::size_t position = pushPosition.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = cells[position & mask];
+            const std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+
+            // the cell is free in this lap
+            if (sequence == position) {
+                if (pushPosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    cell.value = std::move(item);
+                    cell.sequence.store(position + 1,
+                                        std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position) {
+                // still holds the item of the previous lap
+                return false;
+            } else {
+                position = pushPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// @brief Takes the oldest item unless the queue is empty
+    /// @param item set to the item taken
+    /// @return whether an item was taken
+    bool tryPop(T& item) {
+        std::size_t position = popPosition.load(std::memory_order_relaxed);
+
+        while (true) {
+            Cell& cell = cells[position & mask];
+            const std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+
+            // the cell was written in this lap
+            if (sequence == position + 1) {
+                if (popPosition.compare_exchange_weak(
+                        position, position + 1, std::memory_order_relaxed)) {
+                    item = std::move(cell.value);
+                    cell.sequence.store(position + mask + 1,
+                                        std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < position + 1) {
+                return false;
+            } else {
+                position = popPosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// @brief Queues an item, waiting while the queue is full
+    /// @param item item to queue
+    void push(T item) {
+        for (std::size_t attempt = 0; !tryPush(item); attempt++) {
+            wait(attempt);
+        }
+    }
+
+    /// @brief Takes the oldest item, waiting while the queue is empty
+    /// @param item set to the item taken
+    /// @return whether an item was taken, false once the queue is closed and
+    /// empty
+    bool pop(T& item) {
+        for (std::size_t attempt = 0;; attempt++) {
+            if (tryPop(item)) {
+                return true;
+            }
+
+            // everything pushed before close is visible once it is seen
+            if (closed.load(std::memory_order_acquire)) {
+                return tryPop(item);
+            }
+
+            wait(attempt);
+        }
+    }
+
+    /// @brief Tells the consumers that nothing more will be pushed. Must only
+    /// be called once every producer is done
+    void close() { closed.store(true, std::memory_order_release); }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static void wait(std::size_t attempt) {
+        if (attempt < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    std::unique_ptr<Cell[]> cells;
+    std::size_t mask;
+
+    // on lines of their own, producers and consumers do not share them
+    alignas(64) std::atomic<std::size_t> pushPosition = 0;
+    alignas(64) std::atomic<std::size_t> popPosition = 0;
+    alignas(64) std::atomic<bool> closed = false;
+};
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef SPELLCHECKER_CHECK_FILE_H
+#define SPELLCHECKER_CHECK_FILE_H
+
+#include <spellchecker.h>
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Settings of checkFile
+struct CheckFileOptions {
+    std::size_t chunkSize = std::size_t{1} << 20;  // bytes read at a time
+    std::size_t batchSize = 64;  // unknown tokens corrected as one task
+    std::size_t threads = 0;     // per parallel stage, 0 uses the shared pool's
+};
+
+/// @brief Spellchecks a text of any size and writes
+/// "offset<TAB>token<TAB>suggestion,suggestion,..." for every token that is
+/// not a word, in text order. The offset is the position of the token in
+/// bytes. Tokens are runs of letters, and of bytes outside ASCII, that may
+/// hold an apostrophe or a hyphen between two letters; they are looked up
+/// and corrected lowercased.
+///
+/// The text flows through a pipeline of stages connected by BoundedQueues: a
+/// reader cutting it into chunks at token boundaries, tokenizers that
+/// lowercase the tokens and drop the known ones, correction workers and the
+/// calling thread, which writes the results back in order. The tokenizers and
+/// the correction workers run on several threads each. The reader never gets
+/// more than a fixed number of chunks ahead of the writer, so memory use does
+/// not grow with the size of the text
+/// @param path path to the text, or "-" to read stdin
+/// @param isWord function telling whether a lowercased token is a word
+/// @param correct function returning the corrections of a lowercased token,
+/// closest first. It is called from several threads at once
+/// @param output stream the unknown tokens are written to
+/// @param options size of the chunks and batches and number of threads
+/// @return 0 on success, -1 if the text could not be read
+int checkFile(
+    const std::string& path,
+    const std::function<bool(std::string_view)>& isWord,
+    const std::function<std::vector<Suggestion>(const std::string&)>& correct,
+    std::ostream& output, const CheckFileOptions& options = {});
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef SPELLCHECKER_CLUSTER_TREE_H
+#define SPELLCHECKER_CLUSTER_TREE_H
+
+#include <dictionary.h>
+#include <distance_cache.h>
+#include <lev_batch.h>
+#include <spellchecker.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/// @brief Settings of a ClusterTree
+struct ClusterTreeOptions {
+    std::size_t leafSize = 256;  // clusters larger than this are split again
+    std::size_t branches = 4;    // closest nodes followed on every level
+    bool sampled = false;        // top level by partitionAroundSampledMedoids
+    SamplingOptions sampling;    // its samples, and the swaps of every split
+};
+
+/// @brief Tree of medoids over a list of words. The words are split into
+/// clusters around medoids, exactly or on samples, and every cluster with more
+/// than leafSize words is split again with partitionIntoMedoids, until all the
+/// leaves are small enough. A query
+/// only follows the closest branches on every level and scans the leaves it
+/// reaches, so it compares itself to roughly branches * (fanout * depth +
+/// leafSize) words whatever the shape of the clusters. The result is not
+/// guaranteed to be the closest words of the whole list. Nodes are stored in
+/// a flat array in breadth-first order, and the medoids of the children of
+/// every node as well as the words of every leaf are laid out for the batch
+/// kernels
+class ClusterTree {
+public:
+    /// @param words list of unique words to index
+    /// @param options size of the leaves and how they are split
+    ClusterTree(const Dictionary& words, const ClusterTreeOptions& options);
+
+    /// @brief Finds the k words closest to the query among the leaves the
+    /// closest branches lead to
+    /// @param query word to look up
+    /// @param k number of words to return
+    /// @param maxDist largest distance a result may have
+    /// @return up to k words, ordered by distance to the query and then by
+    /// their position in the word list
+    std::vector<Suggestion> nearest(
+        const std::string& query, std::size_t k,
+        int maxDist = std::numeric_limits<int>::max()) const;
+
+    /// @return number of words in the tree
+    std::size_t size() const { return words.size(); }
+
+    /// @return number of leaves
+    std::size_t leafCount() const { return leaves; }
+
+    /// @return number of levels below the root
+    std::size_t depth() const { return levels; }
+
+    /// @return number of words in the largest leaf, larger than leafSize only
+    /// if a cluster could not be split any further
+    std::size_t largestLeaf() const { return largestLeafSize; }
+
+private:
+    // the children of a node are nodes[firstChild..firstChild + childCount),
+    // a leaf has none and holds members[firstMember..+memberCount) instead.
+    // Batch group i belongs to node i: the medoids of its children, with their
+    // positions among them as ids, or the members of a leaf
+    struct Node {
+        std::uint32_t medoid;
+        std::uint32_t firstChild;
+        std::uint32_t childCount;
+        std::uint32_t firstMember;
+        std::uint32_t memberCount;
+    };
+
+    Dictionary words;
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> members;
+    LevBatchWords batches;
+    std::size_t branches;
+
+    std::size_t leaves = 0;
+    std::size_t levels = 0;
+    std::size_t largestLeafSize = 0;
+};
+
+#endif
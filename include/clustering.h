@@ -1,10 +1,15 @@
 #ifndef SPELLCHECKER_CLUSTERING_H
 #define SPELLCHECKER_CLUSTERING_H
 
+#include <stats.h>
+#include <thread_pool.h>
+
 #include <algorithm>
+#include <concepts>
+#include <cstdint>
 #include <functional>
-#include <future>
-#include <thread>
+#include <limits>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -14,9 +19,45 @@ struct DistanceScore {
     int distance;
 };
 
-template <typename T>
+/// @brief Any callable that returns the distance between two points of type T
+/// taken by const reference. The clustering templates are instantiated for the
+/// concrete callable, so calls can be inlined and no point is copied
+template <typename F, typename T>
+concept DistanceFunction = std::invocable<const F&, const T&, const T&> &&
+                           std::convertible_to<
+                               std::invoke_result_t<const F&, const T&, const T&>,
+                               int>;
+
+/// @brief Distance function that can also be called with a third argument,
+/// the largest distance the caller is interested in. It then returns the
+/// exact distance if that is at most maxDist, and any larger value otherwise,
+/// which lets it give up early. The partitioning loops only need to know
+/// whether a point is closer to one medoid than to another, so they pass the
+/// best distance so far as the bound
+template <typename F, typename T>
+concept BoundedDistanceFunction =
+    DistanceFunction<F, T> &&
+    std::invocable<const F&, const T&, const T&, int> &&
+    std::convertible_to<
+        std::invoke_result_t<const F&, const T&, const T&, int>, int>;
+
+// The distance of two points if it is at most maxDist, otherwise any larger
+// value. Falls back to the full distance for plain distance functions
+template <typename T, DistanceFunction<T> Distance>
+inline int distanceWithin(const Distance& distanceFunction, const T& a,
+                          const T& b, int maxDist) {
+    if constexpr (BoundedDistanceFunction<Distance, T>) {
+        return distanceFunction(a, b, maxDist);
+    } else {
+        return distanceFunction(a, b);
+    }
+}
+
+// Runs on the calling thread, it is the inner loop of findCentralMedoid which
+// is already split between the threads of the pool
+template <typename T, DistanceFunction<T> Distance>
 inline int sumOfDistances(const T& input, const std::vector<T>& points,
-                          const std::function<int(T, T)>& distanceFunction) {
+                          const Distance& distanceFunction) {
     int distance = 0;
 
     for (const auto& point : points) {
@@ -26,6 +67,14 @@ inline int sumOfDistances(const T& input, const std::vector<T>& points,
     return distance;
 }
 
+/// @brief Same as above, kept for callers passing a std::function
+template <typename T>
+inline int sumOfDistances(const T& input, const std::vector<T>& points,
+                          const std::function<int(T, T)>& distanceFunction) {
+    return sumOfDistances<T, std::function<int(T, T)>>(input, points,
+                                                       distanceFunction);
+}
+
 template <typename T>
 inline void removeItemsFromSet(std::unordered_set<T>& set,
                                const std::vector<T>& itemsToRemove) {
@@ -38,110 +87,109 @@ inline void removeItemsFromSet(std::unordered_set<T>& set,
     }
 }
 
-template <typename T>
+template <typename T, DistanceFunction<T> Distance>
 inline T findCentralMedoid(const std::vector<T>& points,
-                           const std::function<int(T, T)>& distanceFunction) {
+                           const Distance& distanceFunction) {
     if (points.size() == 0) {
         return T();
     }
 
-    DistanceScore centralPoint = {
-        0, sumOfDistances(points.front(), points, distanceFunction)};
-
-    auto blockStart = points.begin();
-
-    // some of the code is taken from C++ Concurrency in Action, 2nd edition by
-    // Anthony Williams
-    const std::size_t length =
-        static_cast<std::size_t>(std::distance(blockStart, points.end()));
+    const std::size_t minPerTask = 25;
 
-    if (!length) {
-        return points[0];
-    }
-
-    const std::size_t minPerThread = 25;
-    const std::size_t hardwareThreads =
-        static_cast<std::size_t>(std::thread::hardware_concurrency());
+    DistanceScore centralPoint = {0, std::numeric_limits<int>::max()};
+    std::mutex centralPointMutex;
 
-    const std::size_t maxThreads = (length + minPerThread - 1) / minPerThread;
+    parallelFor(points.size(), minPerTask,
+                [&points, &distanceFunction, &centralPoint,
+                 &centralPointMutex](std::size_t chunkBegin, std::size_t chunkEnd) {
+                    // each task finds the most central object among the
+                    // subset that has been given to it
+                    DistanceScore innerCentralPoint = {
+                        chunkBegin, sumOfDistances(points[chunkBegin], points,
+                                                   distanceFunction)};
 
-    // size of a block we want to send to the async function
-    const std::size_t numThreads =
-        std::min(hardwareThreads != 0 ? hardwareThreads : 2, maxThreads);
+                    for (std::size_t i = chunkBegin + 1; i < chunkEnd; i++) {
+                        const int currentDistance =
+                            sumOfDistances(points[i], points, distanceFunction);
 
-    const std::size_t blockSize = length / numThreads;
+                        if (currentDistance < innerCentralPoint.distance) {
+                            innerCentralPoint = {i, currentDistance};
+                        }
+                    }
 
-    std::vector<std::future<DistanceScore>> centralCandidates;
+                    // ties go to the earlier point, so the result does not
+                    // depend on the number of threads
+                    std::lock_guard<std::mutex> lock(centralPointMutex);
 
-    for (std::size_t i = 0; i < (numThreads - 1); i++) {
-        auto blockEnd = blockStart;
-        std::advance(blockEnd, blockSize);
+                    if (innerCentralPoint.distance < centralPoint.distance ||
+                        (innerCentralPoint.distance == centralPoint.distance &&
+                         innerCentralPoint.index < centralPoint.index)) {
+                        centralPoint = innerCentralPoint;
+                    }
+                });
 
-        // each task will find the most central object among the subset that has
-        // been given to it
-        centralCandidates.push_back(std::async(
-            std::launch::async,
-            [blockStart, blockEnd, centralPoint, &points, &distanceFunction]() {
-                DistanceScore innerCentralPoint = centralPoint;
+    return points[centralPoint.index];
+}
 
-                for (auto it = blockStart; it != blockEnd; ++it) {
-                    const int currentDistance =
-                        sumOfDistances(*it, points, distanceFunction);
+/// @brief Same as above, kept for callers passing a std::function
+template <typename T>
+inline T findCentralMedoid(const std::vector<T>& points,
+                           const std::function<int(T, T)>& distanceFunction) {
+    return findCentralMedoid<T, std::function<int(T, T)>>(points,
+                                                          distanceFunction);
+}
 
-                    if (currentDistance < innerCentralPoint.distance) {
-                        const std::size_t index = static_cast<std::size_t>(
-                            std::distance(points.begin(), it));
-                        innerCentralPoint = {index, currentDistance};
-                    }
-                }
+template <typename T, typename Iterator, DistanceFunction<T> Distance>
+inline T findFurthestElement(const T& input, Iterator first, Iterator end,
+                             const Distance& distanceFunction) {
+    const std::size_t minPerTask = 256;
 
-                return innerCentralPoint;
-            }));
+    // works on any forward iterator, e.g. the one of an unordered_set, by
+    // splitting a list of iterators between the threads
+    std::vector<Iterator> items;
 
-        blockStart = blockEnd;
+    for (auto it = first; it != end; ++it) {
+        items.push_back(it);
     }
 
-    // process the last block on the calling thread
-    for (auto it = blockStart; it != points.end(); ++it) {
-        const int currentDistance =
-            sumOfDistances(*it, points, distanceFunction);
+    DistanceScore furthestPoint = {0, distanceFunction(input, *first)};
+    std::mutex furthestPointMutex;
 
-        if (currentDistance < centralPoint.distance) {
-            const std::size_t index =
-                static_cast<std::size_t>(std::distance(points.begin(), it));
+    parallelFor(items.size(), minPerTask,
+                [&input, &items, &distanceFunction, &furthestPoint,
+                 &furthestPointMutex](std::size_t chunkBegin, std::size_t chunkEnd) {
+                    DistanceScore innerFurthestPoint = {
+                        chunkBegin,
+                        distanceFunction(input, *items[chunkBegin])};
 
-            centralPoint = {index, currentDistance};
-        }
-    }
+                    for (std::size_t i = chunkBegin + 1; i < chunkEnd; i++) {
+                        const int currentDistance =
+                            distanceFunction(input, *items[i]);
 
-    // find the most central point among the candidates
-    for (auto& futureCandidates : centralCandidates) {
-        auto candidate = futureCandidates.get();
+                        if (currentDistance > innerFurthestPoint.distance) {
+                            innerFurthestPoint = {i, currentDistance};
+                        }
+                    }
 
-        if (candidate.distance < centralPoint.distance) {
-            centralPoint = candidate;
-        }
-    }
+                    std::lock_guard<std::mutex> lock(furthestPointMutex);
 
-    return points[centralPoint.index];
+                    if (innerFurthestPoint.distance > furthestPoint.distance ||
+                        (innerFurthestPoint.distance ==
+                             furthestPoint.distance &&
+                         innerFurthestPoint.index < furthestPoint.index)) {
+                        furthestPoint = innerFurthestPoint;
+                    }
+                });
+
+    return *items[furthestPoint.index];
 }
 
+/// @brief Same as above, kept for callers passing a std::function
 template <typename T, typename Iterator>
 inline T findFurthestElement(const T& input, Iterator first, Iterator end,
                              const std::function<int(T, T)>& distanceFunction) {
-    T furthestPoint = *(first);
-    int furthestDistance = distanceFunction(input, furthestPoint);
-
-    for (auto it = std::next(first); it != end; ++it) {
-        const int currentDistance = distanceFunction(input, *it);
-
-        if (currentDistance > furthestDistance) {
-            furthestPoint = *it;
-            furthestDistance = currentDistance;
-        }
-    }
-
-    return furthestPoint;
+    return findFurthestElement<T, Iterator, std::function<int(T, T)>>(
+        input, first, end, distanceFunction);
 }
 
 /// @brief Partitions the given list of points into two clusters around the
@@ -155,62 +203,164 @@ inline T findFurthestElement(const T& input, Iterator first, Iterator end,
 /// points
 /// @return map of clusters, where the key is the most central point in a
 /// cluster and value is the cluster itself
-template <typename T>
+template <typename T, DistanceFunction<T> Distance>
 inline std::unordered_map<T, std::vector<T>> partitionIntoClusters(
     const T& firstMedoid, const T& secondMedoid,
-    const std::unordered_set<T>& points,
-    const std::function<int(T, T)>& distanceFunction) {
-    std::unordered_map<T, std::vector<T>> clusterMap;
+    const std::unordered_set<T>& points, const Distance& distanceFunction) {
+    const std::size_t minPerTask = 128;
+
+    std::vector<const T*> orderedPoints;
+    orderedPoints.reserve(points.size());
 
     for (const auto& point : points) {
-        const int distanceToFirst = distanceFunction(point, firstMedoid);
-        const int distanceToSecond = distanceFunction(point, secondMedoid);
+        orderedPoints.push_back(&point);
+    }
+
+    // the distances are calculated in parallel, the clusters are then filled
+    // in the original order. char instead of bool keeps the writes of
+    // different threads apart
+    std::vector<char> closerToFirst(orderedPoints.size());
+
+    parallelFor(orderedPoints.size(), minPerTask,
+                [&](std::size_t chunkBegin, std::size_t chunkEnd) {
+                    for (std::size_t i = chunkBegin; i < chunkEnd; i++) {
+                        const int distanceToFirst =
+                            distanceFunction(*orderedPoints[i], firstMedoid);
 
-        if (distanceToFirst < distanceToSecond) {
-            clusterMap[firstMedoid].push_back(point);
+                        // only whether it is larger than the first matters
+                        const int distanceToSecond = distanceWithin(
+                            distanceFunction, *orderedPoints[i], secondMedoid,
+                            distanceToFirst);
+
+                        closerToFirst[i] = distanceToFirst < distanceToSecond;
+                    }
+                });
+
+    std::unordered_map<T, std::vector<T>> clusterMap;
+
+    for (std::size_t i = 0; i < orderedPoints.size(); i++) {
+        if (closerToFirst[i]) {
+            clusterMap[firstMedoid].push_back(*orderedPoints[i]);
         } else {
-            clusterMap[secondMedoid].push_back(point);
+            clusterMap[secondMedoid].push_back(*orderedPoints[i]);
         }
     }
 
     return clusterMap;
 }
 
+/// @brief Same as above, kept for callers passing a std::function
 template <typename T>
 inline std::unordered_map<T, std::vector<T>> partitionIntoClusters(
-    const std::vector<T>& medoids, const std::vector<T>& points,
+    const T& firstMedoid, const T& secondMedoid,
+    const std::unordered_set<T>& points,
     const std::function<int(T, T)>& distanceFunction) {
-    std::unordered_map<T, std::vector<T>> clusterMap;
+    return partitionIntoClusters<T, std::function<int(T, T)>>(
+        firstMedoid, secondMedoid, points, distanceFunction);
+}
 
-    // for each of the points, find the closest medoid and assign it there
-    for (const auto& point : points) {
-        int shortestDist = distanceFunction(medoids.front(), point);
-        T closestPoint = medoids.front();
+/// @brief Finds the nearest medoid of every point, ties going to the earlier
+/// medoid
+/// @param medoids central points, at least one
+/// @param points points to assign
+/// @param distanceFunction function used to calculate distance between two
+/// points
+/// @return for every point the position of its nearest medoid and the
+/// distance to it
+template <typename T, DistanceFunction<T> Distance>
+inline std::vector<DistanceScore> assignToNearestMedoids(
+    const std::vector<T>& medoids, const std::vector<T>& points,
+    const Distance& distanceFunction) {
+    const std::size_t minPerTask = 32;
+
+    std::vector<DistanceScore> nearestMedoids(points.size());
+
+    parallelFor(points.size(), minPerTask,
+                [&](std::size_t chunkBegin, std::size_t chunkEnd) {
+                    for (std::size_t i = chunkBegin; i < chunkEnd; i++) {
+                        int shortestDist =
+                            distanceFunction(medoids.front(), points[i]);
+                        std::size_t closestMedoid = 0;
+
+                        for (std::size_t m = 1; m < medoids.size(); m++) {
+                            // only distances below the best one matter
+                            const int currentDistance =
+                                distanceWithin(distanceFunction, medoids[m],
+                                               points[i], shortestDist - 1);
+
+                            if (currentDistance < shortestDist) {
+                                shortestDist = currentDistance;
+                                closestMedoid = m;
+                            }
+                        }
+
+                        nearestMedoids[i] = {closestMedoid, shortestDist};
+                    }
+                });
 
-        for (auto it = std::next(medoids.begin()); it != medoids.end(); ++it) {
-            int currentDistance = distanceFunction(*it, point);
+    return nearestMedoids;
+}
 
-            if (currentDistance < shortestDist) {
-                shortestDist = currentDistance;
-                closestPoint = *it;
-            }
-        }
+template <typename T, DistanceFunction<T> Distance>
+inline std::unordered_map<T, std::vector<T>> partitionIntoClusters(
+    const std::vector<T>& medoids, const std::vector<T>& points,
+    const Distance& distanceFunction) {
+    // for each of the points, find the closest medoid and assign it there
+    const auto nearestMedoids =
+        assignToNearestMedoids(medoids, points, distanceFunction);
+
+    std::unordered_map<T, std::vector<T>> clusterMap;
 
-        clusterMap[closestPoint].push_back(point);
+    for (std::size_t i = 0; i < points.size(); i++) {
+        clusterMap[medoids[nearestMedoids[i].index]].push_back(points[i]);
     }
 
     return clusterMap;
 }
 
+/// @brief Same as above, kept for callers passing a std::function
+template <typename T>
+inline std::unordered_map<T, std::vector<T>> partitionIntoClusters(
+    const std::vector<T>& medoids, const std::vector<T>& points,
+    const std::function<int(T, T)>& distanceFunction) {
+    return partitionIntoClusters<T, std::function<int(T, T)>>(
+        medoids, points, distanceFunction);
+}
+
+/// @brief Counts the points that moved into or out of a cluster when its
+/// medoid was recalculated
+/// @param previousCluster members of the cluster before the recalculation
+/// @param cluster members of the cluster after it
 template <typename T>
+inline void recordReassignments(const std::vector<T>& previousCluster,
+                                const std::vector<T>& cluster) {
+    const std::unordered_set<T> previousMembers(previousCluster.begin(),
+                                                previousCluster.end());
+    std::size_t stayed = 0;
+
+    for (const auto& point : cluster) {
+        stayed += previousMembers.count(point);
+    }
+
+    // everything that is not in both clusters has moved
+    const auto reassignments = static_cast<std::uint64_t>(
+        previousCluster.size() + cluster.size() - 2 * stayed);
+
+    statsAdd(StatCounter::ClusteringReassignments, reassignments);
+    statsRecord(StatHistogram::ReassignmentsPerRefinement, reassignments);
+}
+
+template <typename T, DistanceFunction<T> Distance, typename Centrality>
 inline std::vector<T> anomalousPatternInitialisation(
-    const std::vector<T>& points,
-    const std::function<int(T, T)>& distanceFunction,
-    const std::function<T(const std::vector<T>&)>& centralityFunction) {
+    const std::vector<T>& points, const Distance& distanceFunction,
+    const Centrality& centralityFunction) {
     std::vector<T> medoids;
 
     // find the most central element
-    const T startingMedoid = findCentralMedoid(points, distanceFunction);
+    const T startingMedoid = [&]() {
+        const StatsTimer timer(StatCounter::CentralMedoidNanoseconds);
+        return findCentralMedoid(points, distanceFunction);
+    }();
 
     std::unordered_set<T> remaining;
 
@@ -220,20 +370,37 @@ inline std::vector<T> anomalousPatternInitialisation(
 
     // repeat until we run out of points
     while (remaining.size() != 0) {
+        statsAdd(StatCounter::ClusteringRounds);
+
         // find the element furthest away from the central
-        T furthestMedoid =
-            findFurthestElement<T>(startingMedoid, remaining.begin(),
-                                   remaining.end(), distanceFunction);
-        std::unordered_map<T, std::vector<T>> clusterMap =
-            partitionIntoClusters(startingMedoid, furthestMedoid, remaining,
-                                  distanceFunction);
+        T furthestMedoid = [&]() {
+            const StatsTimer timer(StatCounter::FurthestElementNanoseconds);
+            return findFurthestElement(startingMedoid, remaining.begin(),
+                                       remaining.end(), distanceFunction);
+        }();
+        std::unordered_map<T, std::vector<T>> clusterMap = [&]() {
+            const StatsTimer timer(StatCounter::SplitNanoseconds);
+            return partitionIntoClusters(startingMedoid, furthestMedoid,
+                                         remaining, distanceFunction);
+        }();
 
         T newFurthestMedoid;
         do {
+            const StatsTimer timer(StatCounter::RefinementNanoseconds);
+            statsAdd(StatCounter::ClusteringRefinements);
+
+            const std::vector<T> previousCluster =
+                statsEnabled ? clusterMap[furthestMedoid] : std::vector<T>();
+
             newFurthestMedoid = centralityFunction(clusterMap[furthestMedoid]);
             furthestMedoid = newFurthestMedoid;
             clusterMap = partitionIntoClusters(startingMedoid, furthestMedoid,
                                                remaining, distanceFunction);
+
+            if constexpr (statsEnabled) {
+                recordReassignments(previousCluster,
+                                    clusterMap[newFurthestMedoid]);
+            }
         } while (newFurthestMedoid != furthestMedoid);
 
         // remove all the points that are in the furthest cluster from the set
@@ -247,6 +414,17 @@ inline std::vector<T> anomalousPatternInitialisation(
     return medoids;
 }
 
+/// @brief Same as above, kept for callers passing std::functions
+template <typename T>
+inline std::vector<T> anomalousPatternInitialisation(
+    const std::vector<T>& points,
+    const std::function<int(T, T)>& distanceFunction,
+    const std::function<T(const std::vector<T>&)>& centralityFunction) {
+    return anomalousPatternInitialisation<
+        T, std::function<int(T, T)>, std::function<T(const std::vector<T>&)>>(
+        points, distanceFunction, centralityFunction);
+}
+
 /// @brief Partitions a list of points into clusters using the PAM (Partitioning
 /// Around Medoids) approach. The function first determines optimal medoids
 /// (central representative points) and then assigns each point to the cluster
@@ -259,10 +437,10 @@ inline std::vector<T> anomalousPatternInitialisation(
 /// in a set of points (used to select medoids).
 /// @return An unordered_map where each key is a medoid and the corresponding
 /// value is the vector of points assigned to that medoid's cluster.
-template <typename T>
+template <typename T, DistanceFunction<T> Distance, typename Centrality>
 inline std::unordered_map<T, std::vector<T>> partitionAroundMedoids(
-    const std::vector<T>& points, std::function<int(T, T)> distanceFunction,
-    const std::function<T(const std::vector<T>&)>& centralityFunction) {
+    const std::vector<T>& points, const Distance& distanceFunction,
+    const Centrality& centralityFunction) {
     // find the most optimal medoids (points that will be used to represent
     // clusters)
     const auto medoids = anomalousPatternInitialisation(
@@ -273,6 +451,16 @@ inline std::unordered_map<T, std::vector<T>> partitionAroundMedoids(
     return partitionIntoClusters(medoids, points, distanceFunction);
 }
 
+/// @brief Same as above, kept for callers passing std::functions
+template <typename T>
+inline std::unordered_map<T, std::vector<T>> partitionAroundMedoids(
+    const std::vector<T>& points, std::function<int(T, T)> distanceFunction,
+    const std::function<T(const std::vector<T>&)>& centralityFunction) {
+    return partitionAroundMedoids<T, std::function<int(T, T)>,
+                                  std::function<T(const std::vector<T>&)>>(
+        points, distanceFunction, centralityFunction);
+}
+
 /// @brief Partitions a list of points into clusters using the PAM (Partitioning
 /// Around Medoids) approach. The function selects initial medoids and then
 /// assigns each point to the cluster of the nearest medoid. The process stops
@@ -283,15 +471,206 @@ inline std::unordered_map<T, std::vector<T>> partitionAroundMedoids(
 /// points.
 /// @return An unordered_map where each key is a medoid and the corresponding
 /// value is the vector of points assigned to that medoid's cluster.
-template <typename T>
+template <typename T, DistanceFunction<T> Distance>
 inline std::unordered_map<T, std::vector<T>> partitionAroundMedoids(
-    const std::vector<T>& points,
-    const std::function<int(T, T)>& distanceFunction) {
-    return partitionAroundMedoids<T>(
+    const std::vector<T>& points, const Distance& distanceFunction) {
+    return partitionAroundMedoids(
         points, distanceFunction,
         [&distanceFunction](const std::vector<T>& innerPoints) {
             return findCentralMedoid(innerPoints, distanceFunction);
         });
 }
 
+/// @brief Same as above, kept for callers passing a std::function
+template <typename T>
+inline std::unordered_map<T, std::vector<T>> partitionAroundMedoids(
+    const std::vector<T>& points,
+    const std::function<int(T, T)>& distanceFunction) {
+    return partitionAroundMedoids<T, std::function<int(T, T)>>(
+        points, distanceFunction);
+}
+
+/// @brief Improves a set of medoids with the eager swaps of FasterPAM
+/// (Schubert and Rousseeuw). Every point in turn is tried in place of the
+/// medoid whose removal costs the least, and the swap is made at once if it
+/// lowers the sum of the distances of the points to their nearest medoid. The
+/// nearest and second nearest medoid of every point are kept, so a try takes
+/// one distance per point. The distances are always asked for in full, as the
+/// same pairs come up in every pass and a DistanceCache only keeps exact ones.
+/// Stops after a whole pass over the points without a swap, or after maxPasses
+/// passes
+/// @param points points to cluster
+/// @param medoids positions in points of the initial medoids, all different
+/// @param distanceFunction function used to calculate distance between two
+/// points
+/// @param maxPasses largest number of passes over the points
+/// @return positions in points of the improved medoids
+template <typename T, DistanceFunction<T> Distance>
+inline std::vector<std::size_t> swapMedoids(const std::vector<T>& points,
+                                            std::vector<std::size_t> medoids,
+                                            const Distance& distanceFunction,
+                                            std::size_t maxPasses) {
+    const std::size_t minPerTask = 256;
+    const std::size_t pointCount = points.size();
+    const std::size_t medoidCount = medoids.size();
+
+    if (medoidCount == 0 || pointCount <= medoidCount) {
+        return medoids;
+    }
+
+    // distance to a second medoid that does not exist. Large enough to never
+    // be beaten, small enough that the losses can add it up for every point
+    constexpr std::int64_t noMedoid = std::int64_t{1} << 40;
+
+    struct Nearest {
+        std::size_t first;
+        std::int64_t firstDistance;
+        std::size_t second;
+        std::int64_t secondDistance;
+    };
+
+    const auto findNearest = [&](std::size_t point) {
+        Nearest nearest = {0, noMedoid, 0, noMedoid};
+
+        for (std::size_t m = 0; m < medoidCount; m++) {
+            const std::int64_t distance =
+                distanceFunction(points[point], points[medoids[m]]);
+
+            if (distance < nearest.firstDistance) {
+                nearest.second = nearest.first;
+                nearest.secondDistance = nearest.firstDistance;
+                nearest.first = m;
+                nearest.firstDistance = distance;
+            } else if (distance < nearest.secondDistance) {
+                nearest.second = m;
+                nearest.secondDistance = distance;
+            }
+        }
+
+        return nearest;
+    };
+
+    std::vector<Nearest> nearest(pointCount);
+    std::vector<char> isMedoid(pointCount);
+
+    for (const auto medoid : medoids) {
+        isMedoid[medoid] = 1;
+    }
+
+    parallelFor(pointCount, minPerTask,
+                [&](std::size_t chunkBegin, std::size_t chunkEnd) {
+                    for (std::size_t i = chunkBegin; i < chunkEnd; i++) {
+                        nearest[i] = findNearest(i);
+                    }
+                });
+
+    // how much the sum grows if a medoid is removed and its points move to
+    // their second nearest medoid
+    const auto removalLosses = [&]() {
+        std::vector<std::int64_t> losses(medoidCount);
+
+        for (const auto& point : nearest) {
+            losses[point.first] += point.secondDistance - point.firstDistance;
+        }
+
+        return losses;
+    };
+
+    std::vector<std::int64_t> losses = removalLosses();
+    std::mutex changeMutex;
+    std::size_t sinceSwap = 0;
+
+    for (std::size_t tried = 0, candidate = 0;
+         sinceSwap < pointCount && tried < maxPasses * pointCount;
+         tried++, sinceSwap++, candidate = (candidate + 1) % pointCount) {
+        if (isMedoid[candidate]) {
+            continue;
+        }
+
+        // change of the sum when the candidate replaces each of the medoids,
+        // and the part of it that does not depend on which one is replaced
+        std::vector<std::int64_t> change = losses;
+        std::int64_t sharedChange = 0;
+
+        parallelFor(
+            pointCount, minPerTask,
+            [&](std::size_t chunkBegin, std::size_t chunkEnd) {
+                std::vector<std::int64_t> innerChange(medoidCount);
+                std::int64_t innerSharedChange = 0;
+
+                for (std::size_t i = chunkBegin; i < chunkEnd; i++) {
+                    const Nearest& point = nearest[i];
+                    const std::int64_t distance =
+                        distanceFunction(points[i], points[candidate]);
+
+                    if (distance < point.firstDistance) {
+                        // the point moves to the candidate whichever medoid
+                        // goes, the removal loss of its own is void
+                        innerSharedChange += distance - point.firstDistance;
+                        innerChange[point.first] +=
+                            point.firstDistance - point.secondDistance;
+                    } else if (distance < point.secondDistance) {
+                        // if its medoid goes, it moves to the candidate
+                        // rather than to the second nearest medoid
+                        innerChange[point.first] +=
+                            distance - point.secondDistance;
+                    }
+                }
+
+                // integer sums, the order the tasks finish in does not matter
+                std::lock_guard<std::mutex> lock(changeMutex);
+
+                for (std::size_t m = 0; m < medoidCount; m++) {
+                    change[m] += innerChange[m];
+                }
+
+                sharedChange += innerSharedChange;
+            });
+
+        const auto replaced = static_cast<std::size_t>(
+            std::ranges::min_element(change) - change.begin());
+
+        if (change[replaced] + sharedChange >= 0) {
+            continue;
+        }
+
+        statsAdd(StatCounter::ClusteringSwaps);
+
+        isMedoid[medoids[replaced]] = 0;
+        isMedoid[candidate] = 1;
+        medoids[replaced] = candidate;
+
+        parallelFor(pointCount, minPerTask,
+                    [&](std::size_t chunkBegin, std::size_t chunkEnd) {
+                        for (std::size_t i = chunkBegin; i < chunkEnd; i++) {
+                            Nearest& point = nearest[i];
+
+                            if (point.first == replaced ||
+                                point.second == replaced) {
+                                point = findNearest(i);
+                                continue;
+                            }
+
+                            const std::int64_t distance = distanceFunction(
+                                points[i], points[candidate]);
+
+                            if (distance < point.firstDistance) {
+                                point.second = point.first;
+                                point.secondDistance = point.firstDistance;
+                                point.first = replaced;
+                                point.firstDistance = distance;
+                            } else if (distance < point.secondDistance) {
+                                point.second = replaced;
+                                point.secondDistance = distance;
+                            }
+                        }
+                    });
+
+        losses = removalLosses();
+        sinceSwap = 0;
+    }
+
+    return medoids;
+}
+
 #endif
@@ -0,0 +1,312 @@
+#ifndef SPELLCHECKER_DICTIONARY_H
+#define SPELLCHECKER_DICTIONARY_H
+
+#include <lev_batch.h>
+#include <spellchecker.h>
+#include <word_signature.h>
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// @brief List of unique words stored back to back in one contiguous arena.
+/// Word i is blob[offsets[i]..offsets[i + 1]), so the whole dictionary costs
+/// its bytes plus four bytes per word, and words are referred to by their
+/// 32-bit index everywhere else. The signature of every word is kept next to
+/// it for the filter cascade.
+///
+/// Words are looked up in an open-addressing table of groups of 16 slots,
+/// probed group after group. Next to the word index, every slot keeps 7 bits
+/// of the hash of its word as a tag, and the 16 tags of a group are compared
+/// to the tag of the word at once (SSE2 on x86-64), so a lookup reads the
+/// word itself only for slots whose tags match, which is about once per hit
+/// and almost never for a miss
+class Dictionary {
+public:
+    /// @brief Index returned by find for words that are not in the dictionary
+    static constexpr std::uint32_t npos =
+        std::numeric_limits<std::uint32_t>::max();
+
+    /// @brief Group of slots of the lookup table. Slot i holds the word
+    /// words[i] if its tag tags[i] has the top bit clear, and is empty
+    /// otherwise. A group fills one cache line, so a hit reads one line of the
+    /// table and the word. The last 4 tags pad the tags to 16 bytes and never
+    /// match anything
+    struct alignas(64) SlotGroup {
+        std::array<std::uint8_t, 16> tags;
+        std::array<std::uint32_t, 12> words;
+    };
+
+    /// @brief Adds a word unless it is already in the dictionary
+    /// @param word word to add
+    /// @return index of the word and whether it was added
+    std::pair<std::uint32_t, bool> insert(std::string_view word);
+
+    /// @brief Same as above, with the hash and the signature of the word
+    /// already calculated, e.g. by a loader working on several threads
+    /// @param word word to add
+    /// @param hash hash of the word, see hash()
+    /// @param signature signature of the word, see wordSignature
+    /// @return index of the word and whether it was added
+    std::pair<std::uint32_t, bool> insert(std::string_view word,
+                                          std::uint64_t hash,
+                                          const WordSignature& signature);
+
+    /// @param word a word
+    /// @return hash of the word as used by the lookup table
+    static std::uint64_t hash(std::string_view word);
+
+    /// @param word word to look up
+    /// @return index of the word, or npos if it is not in the dictionary
+    std::uint32_t find(std::string_view word) const;
+
+    /// @brief Looks a word up in a lookup table kept elsewhere, e.g. in a
+    /// mapped index file, without copying anything
+    /// @param word word to look up
+    /// @param table lookup table, see lookupTable
+    /// @param wordOffsets start of every word in blob, followed by its size
+    /// @param blob all words stored back to back
+    /// @return index of the word, or npos if it is not in the table
+    static std::uint32_t find(std::string_view word,
+                              std::span<const SlotGroup> table,
+                              std::span<const std::uint32_t> wordOffsets,
+                              std::string_view blob);
+
+    /// @param table a lookup table, e.g. read from a file
+    /// @param wordCount number of words the table is for
+    /// @return whether find can probe the table without reading outside of it
+    /// or the words, and without probing forever
+    static bool isValidLookupTable(std::span<const SlotGroup> table,
+                                   std::size_t wordCount);
+
+    /// @brief Reserves space for words of the given total size, lookup table
+    /// included
+    /// @param wordCount expected number of words
+    /// @param byteCount expected number of bytes of all words together
+    void reserve(std::size_t wordCount, std::size_t byteCount);
+
+    /// @return number of words
+    std::size_t size() const { return offsets.size() - 1; }
+
+    bool empty() const { return size() == 0; }
+
+    /// @param index index of a word
+    /// @return the word, valid until the next insert
+    std::string_view operator[](std::uint32_t index) const {
+        return std::string_view(blob).substr(
+            offsets[index], offsets[index + 1] - offsets[index]);
+    }
+
+    /// @return all words stored back to back
+    std::string_view bytes() const { return blob; }
+
+    /// @return start of every word in bytes(), followed by the size of bytes()
+    std::span<const std::uint32_t> wordOffsets() const { return offsets; }
+
+    /// @return signature of every word, in the order of the words
+    std::span<const WordSignature> signatures() const {
+        return wordSignatures;
+    }
+
+    /// @return lookup table of the words, as used by find
+    std::span<const SlotGroup> lookupTable() const { return table; }
+
+    /// @return approximate number of bytes held by the dictionary
+    std::size_t memoryUsage() const;
+
+private:
+    // position of a slot, the group and the slot in it
+    struct Slot {
+        std::size_t group;
+        std::size_t index;
+    };
+
+    // position of the word in a lookup table, or of the empty slot it would
+    // go into
+    static Slot slotIn(std::span<const SlotGroup> table,
+                       std::span<const std::uint32_t> wordOffsets,
+                       std::string_view blob, std::string_view word,
+                       std::uint64_t wordHash);
+
+    // same as above, in the table of this dictionary
+    Slot slotOf(std::string_view word, std::uint64_t wordHash) const {
+        return slotIn(table, offsets, blob, word, wordHash);
+    }
+
+    // makes room in the lookup table for the given number of words
+    void growTable(std::size_t wordCount);
+
+    std::string blob;
+    std::vector<std::uint32_t> offsets = {0};
+    std::vector<WordSignature> wordSignatures;
+
+    std::vector<SlotGroup> table;
+};
+
+/// @brief How far a cluster may drift from the state its medoid was chosen in
+/// before the medoid is chosen again, see ClusterIndex::addWord
+struct ClusterDriftLimits {
+    // words added or removed since, as a fraction of the size the cluster had
+    double sizeChange = 0.1;
+
+    // change of the mean distance of the members to the medoid, as a fraction
+    // of the mean it had
+    double costChange = 0.1;
+};
+
+/// @brief What an update of a ClusterIndex did
+struct ClusterUpdate {
+    bool changed;           // false if the word was already there or missing
+    std::uint32_t cluster;  // cluster the word was added to or removed from
+    bool medoidChosen;      // the medoid of the cluster was chosen again
+    bool clusterRemoved;    // the word was the last one of its cluster
+};
+
+/// @brief Dictionary split into clusters, owning everything a ClusterIndexView
+/// points to. Clusters are arrays of word indices laid out contiguously, and
+/// the members of a cluster are sorted by length so a scan walks words of
+/// similar size together, and then by their distance to the medoid, so the
+/// words a query rules out with the triangle inequality share batch blocks.
+/// The clusters are also laid out for the batch kernels, see
+/// batchClusterIndex.
+///
+/// Words can be added and removed without clustering again: a new word joins
+/// the cluster of its nearest medoid, and the medoid of a cluster is only
+/// chosen again with findCentralMedoid once the cluster drifted past the
+/// ClusterDriftLimits. Updates must not run while the view is being read
+class ClusterIndex {
+public:
+    ClusterIndex() = default;
+
+    /// @param words words that were clustered
+    /// @param clusters clusters of word indices, keyed by the index of their
+    /// medoid, as returned by partitionAroundMedoids
+    ClusterIndex(
+        Dictionary words,
+        const std::unordered_map<std::uint32_t, std::vector<std::uint32_t>>&
+            clusters);
+
+    // the view points into the arrays, so it is rebuilt whenever they move.
+    // A short blob lives inside the string object and moves with it
+    ClusterIndex(const ClusterIndex&) = delete;
+    ClusterIndex& operator=(const ClusterIndex&) = delete;
+    ClusterIndex(ClusterIndex&& other) noexcept;
+    ClusterIndex& operator=(ClusterIndex&& other) noexcept;
+
+    /// @return view of the words and clusters
+    const ClusterIndexView& view() const { return indexView; }
+
+    /// @return the clustered words
+    const Dictionary& dictionary() const { return words; }
+
+    /// @param word word to look up
+    /// @return index of the word, or Dictionary::npos if it is not part of
+    /// any cluster, e.g. because it was removed
+    std::uint32_t find(std::string_view word) const {
+        const std::uint32_t index = words.find(word);
+
+        return index == Dictionary::npos || clusterOf[index] == Dictionary::npos
+                   ? Dictionary::npos
+                   : index;
+    }
+
+    /// @brief Adds a word to the cluster of the medoid closest to it, ties go
+    /// to the lower cluster. The medoid of that cluster is chosen again if the
+    /// cluster drifted too far, see setDriftLimits
+    /// @param word word to add
+    /// @return what was done, nothing if the word is already in the index
+    ClusterUpdate addWord(std::string_view word);
+
+    /// @brief Removes a word from its cluster. The medoid of the cluster is
+    /// chosen again if the word was the medoid or the cluster drifted too far,
+    /// and a cluster left without words is removed, so the clusters after it
+    /// move down by one. The word stays in the dictionary but is no longer
+    /// part of any cluster
+    /// @param word word to remove
+    /// @return what was done, nothing if the word is not in the index
+    ClusterUpdate removeWord(std::string_view word);
+
+    /// @param limits how far a cluster may drift before its medoid is chosen
+    /// again
+    void setDriftLimits(const ClusterDriftLimits& limits) {
+        driftLimits = limits;
+    }
+
+    /// @return approximate number of bytes held by the index, words included
+    std::size_t memoryUsage() const;
+
+private:
+    // state of a cluster since its medoid was chosen, costs are sums of the
+    // distances of the members to the medoid
+    struct ClusterDrift {
+        std::uint32_t selectedSize;
+        std::uint64_t selectedCost;
+        std::uint64_t cost;
+        std::uint32_t changes;
+    };
+
+    void updateView();
+
+    bool comesBefore(std::uint32_t a, std::uint32_t b) const;
+    bool hasDrifted(std::uint32_t cluster) const;
+    void chooseMedoid(std::uint32_t cluster);
+    void assignAround(std::uint32_t cluster);
+    void removeCluster(std::uint32_t cluster);
+    void layOutCluster(std::uint32_t cluster);
+    void measureRadius(std::uint32_t cluster);
+    void layOutMedoids();
+
+    Dictionary words;
+    std::vector<std::uint32_t> medoids;
+    std::vector<std::uint32_t> clusterStarts;
+    std::vector<std::uint32_t> members;
+    std::unique_ptr<LevBatchWords> batches;
+
+    // cluster of every word of the dictionary, npos for removed words, and
+    // the distance of the word to the medoid of its cluster. No other medoid
+    // is closer to a word than its own, so a query finds the cluster of every
+    // word it matches exactly
+    std::vector<std::uint32_t> clusterOf;
+    std::vector<std::uint32_t> medoidDistances;
+
+    // largest distance of a member to the medoid, for every cluster
+    std::vector<std::uint32_t> radii;
+    std::vector<ClusterDrift> drift;
+    ClusterDriftLimits driftLimits;
+
+    ClusterIndexView indexView;
+};
+
+/// @brief Distance between two words of a dictionary, given by their indices.
+/// Called with a bound it runs the filter cascade before levBounded, see
+/// BoundedDistanceFunction
+struct DictionaryDistance {
+    const Dictionary* words;
+
+    int operator()(std::uint32_t a, std::uint32_t b) const;
+    int operator()(std::uint32_t a, std::uint32_t b, int maxDist) const;
+};
+
+struct SamplingOptions;
+
+/// @brief Splits a dictionary into clusters with partitionAroundMedoidsCached
+/// @param words words to cluster
+/// @return the words and their clusters
+ClusterIndex clusterDictionary(Dictionary words);
+
+/// @brief Splits a dictionary into clusters with partitionAroundSampledMedoids,
+/// which scales to dictionaries far too large for the exact search
+/// @param words words to cluster
+/// @param options sizes of the samples and the seed they are drawn with
+/// @return the words and their clusters
+ClusterIndex clusterDictionary(Dictionary words,
+                               const SamplingOptions& options);
+
+#endif
@@ -0,0 +1,423 @@
+#ifndef SPELLCHECKER_DISTANCE_CACHE_H
+#define SPELLCHECKER_DISTANCE_CACHE_H
+
+#include <clustering.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// @brief Memoises the distances between the points of a fixed list so that
+/// repeated clustering passes do not recompute the same pairs. Points are
+/// addressed by their index in the list. Small lists get a compact triangular
+/// matrix with one byte per pair, large lists a bounded sharded hash cache.
+/// Safe to use from several threads at once
+/// @tparam T Type of the points.
+/// @tparam Distance Type of the function calculating the distance on a miss.
+template <typename T, DistanceFunction<T> Distance =
+                          std::function<int(const T&, const T&)>>
+class DistanceCache {
+public:
+    /// @brief default amount of memory the cache may use, in bytes
+    static constexpr std::size_t defaultMemoryBudget = std::size_t{256} << 20;
+
+    /// @param cachedPoints list of points. Must outlive the cache
+    /// @param missFunction function used to calculate distance between two
+    /// points on a cache miss
+    /// @param memoryBudget amount of memory the cache may use, in bytes. The
+    /// triangular matrix is used when it fits into the budget
+    DistanceCache(const std::vector<T>& cachedPoints, Distance missFunction,
+                  std::size_t memoryBudget = defaultMemoryBudget)
+        : points(cachedPoints), distanceFunction(std::move(missFunction)) {
+        const std::size_t size = points.size();
+        const std::size_t pairs = size > 1 ? size * (size - 1) / 2 : 0;
+
+        if (pairs <= memoryBudget) {
+            matrix = std::make_unique<std::atomic<std::uint8_t>[]>(pairs);
+
+            for (std::size_t i = 0; i < pairs; i++) {
+                matrix[i].store(unknown, std::memory_order_relaxed);
+            }
+        } else {
+            shardCapacity = std::max<std::size_t>(
+                memoryBudget / (bytesPerEntry * shardCount), 1);
+        }
+    }
+
+    /// @brief Returns the distance between two points, calculating it on the
+    /// first request only
+    /// @param a index of the first point
+    /// @param b index of the second point
+    /// @return distance between points[a] and points[b]
+    int operator()(std::uint32_t a, std::uint32_t b) const {
+        if (a == b) {
+            return 0;
+        }
+
+        if (a > b) {
+            std::swap(a, b);
+        }
+
+        if (matrix) {
+            return matrixLookup(a, b, unbounded);
+        }
+
+        return shardLookup(a, b, unbounded);
+    }
+
+    /// @brief Returns the distance between two points if it is at most
+    /// maxDist and any larger value otherwise, see BoundedDistanceFunction.
+    /// Only exact distances are remembered
+    /// @param a index of the first point
+    /// @param b index of the second point
+    /// @param maxDist largest distance the caller is interested in
+    /// @return distance between points[a] and points[b], or a value larger
+    /// than maxDist
+    int operator()(std::uint32_t a, std::uint32_t b, int maxDist) const {
+        if (a == b) {
+            return 0;
+        }
+
+        if (a > b) {
+            std::swap(a, b);
+        }
+
+        if (matrix) {
+            return matrixLookup(a, b, maxDist);
+        }
+
+        return shardLookup(a, b, maxDist);
+    }
+
+    /// @return true if the distances are kept in the triangular matrix
+    bool isDense() const { return matrix != nullptr; }
+
+private:
+    static constexpr std::uint8_t unknown = 0xFF;
+    static constexpr int unbounded = std::numeric_limits<int>::max();
+    static constexpr std::size_t shardCount = 64;
+
+    // rough cost of one entry in an unordered_map node, including the bucket
+    static constexpr std::size_t bytesPerEntry = 32;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::uint64_t, std::uint8_t> distances;
+    };
+
+    // distances that do not fit into a byte are never cached
+    static bool isCacheable(int distance) {
+        return distance >= 0 && distance < unknown;
+    }
+
+    int calculate(std::uint32_t a, std::uint32_t b, int maxDist) const {
+        if (maxDist == unbounded) {
+            return distanceFunction(points[a], points[b]);
+        }
+
+        return distanceWithin(distanceFunction, points[a], points[b], maxDist);
+    }
+
+    int matrixLookup(std::uint32_t a, std::uint32_t b, int maxDist) const {
+        // row-major lower triangle without the diagonal, b > a
+        const std::size_t index =
+            static_cast<std::size_t>(b) * (static_cast<std::size_t>(b) - 1) /
+                2 +
+            a;
+
+        const std::uint8_t cached =
+            matrix[index].load(std::memory_order_relaxed);
+
+        if (cached != unknown) {
+            return cached;
+        }
+
+        const int distance = calculate(a, b, maxDist);
+
+        // racing threads compute the same value, whoever stores last wins
+        if (distance <= maxDist && isCacheable(distance)) {
+            matrix[index].store(static_cast<std::uint8_t>(distance),
+                                std::memory_order_relaxed);
+        }
+
+        return distance;
+    }
+
+    int shardLookup(std::uint32_t a, std::uint32_t b, int maxDist) const {
+        const std::uint64_t key = (static_cast<std::uint64_t>(a) << 32) | b;
+        Shard& shard = shards[(key * 0x9E3779B97F4A7C15ull) >> 58];
+
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            const auto result = shard.distances.find(key);
+
+            if (result != shard.distances.end()) {
+                return result->second;
+            }
+        }
+
+        // computed outside of the lock so other threads are not held up
+        const int distance = calculate(a, b, maxDist);
+
+        if (distance <= maxDist && isCacheable(distance)) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            // a full shard starts over rather than tracking recency, the
+            // clustering passes revisit the same pairs in bursts anyway
+            if (shard.distances.size() >= shardCapacity) {
+                shard.distances.clear();
+            }
+
+            shard.distances.emplace(key, static_cast<std::uint8_t>(distance));
+        }
+
+        return distance;
+    }
+
+    const std::vector<T>& points;
+    Distance distanceFunction;
+
+    std::unique_ptr<std::atomic<std::uint8_t>[]> matrix;
+
+    std::size_t shardCapacity = 0;
+    mutable std::array<Shard, shardCount> shards;
+};
+
+/// @brief Same as partitionAroundMedoids, but runs the clustering over point
+/// indices with every distance served by a DistanceCache, so pairs revisited
+/// by the repeated medoid searches are only calculated once
+/// @tparam T Type of the points.
+/// @param points List of points to partition into clusters.
+/// @param distanceFunction Function used to calculate the distance between two
+/// points.
+/// @param memoryBudget amount of memory the cache may use, in bytes
+/// @return An unordered_map where each key is a medoid and the corresponding
+/// value is the vector of points assigned to that medoid's cluster.
+template <typename T, DistanceFunction<T> Distance>
+inline std::unordered_map<T, std::vector<T>> partitionAroundMedoidsCached(
+    const std::vector<T>& points, const Distance& distanceFunction,
+    std::size_t memoryBudget =
+        DistanceCache<T, Distance>::defaultMemoryBudget) {
+    const DistanceCache<T, Distance> cache(points, distanceFunction,
+                                           memoryBudget);
+
+    std::vector<std::uint32_t> indices(points.size());
+
+    for (std::size_t i = 0; i < indices.size(); i++) {
+        indices[i] = static_cast<std::uint32_t>(i);
+    }
+
+    // the cache is passed as it is, so the partitioning loops can use its
+    // bounded calls
+    const auto indexClusters =
+        partitionAroundMedoids<std::uint32_t>(indices, cache);
+
+    std::unordered_map<T, std::vector<T>> clusterMap;
+
+    for (const auto& [medoid, members] : indexClusters) {
+        std::vector<T>& cluster = clusterMap[points[medoid]];
+        cluster.reserve(members.size());
+
+        for (const auto member : members) {
+            cluster.push_back(points[member]);
+        }
+    }
+
+    return clusterMap;
+}
+
+/// @brief Same as above, kept for callers passing a std::function
+template <typename T>
+inline std::unordered_map<T, std::vector<T>> partitionAroundMedoidsCached(
+    const std::vector<T>& points,
+    const std::function<int(T, T)>& distanceFunction,
+    std::size_t memoryBudget = DistanceCache<T>::defaultMemoryBudget) {
+    return partitionAroundMedoidsCached<T, std::function<int(T, T)>>(
+        points, distanceFunction, memoryBudget);
+}
+
+/// @brief Settings of partitionAroundSampledMedoids. Larger and more samples
+/// give medoids closer to those of the exact search, and take longer
+struct SamplingOptions {
+    std::size_t sampleSize = 2000;  // points in each sample
+    std::size_t samples = 5;        // samples drawn, the best medoids are kept
+    std::uint64_t seed = 1;         // the same seed draws the same samples
+    std::size_t swapPasses = 4;     // passes of swapMedoids over a sample
+};
+
+/// @brief Partitions a list of points around medoids chosen on random samples
+/// of it (CLARA), for lists too large for partitionAroundMedoidsCached. The
+/// first sample is clustered with the anomalous pattern search, which also
+/// settles the number of clusters. Every further sample holds the best
+/// medoids so far and other random points. The medoids of each sample are
+/// improved with swapMedoids, then all the points are assigned to their
+/// nearest medoid, and the medoids with the smallest sum of distances win.
+/// Within a sample the distances are served by a DistanceCache
+/// @tparam T Type of the points.
+/// @param points List of points to partition into clusters.
+/// @param distanceFunction Function used to calculate the distance between two
+/// points.
+/// @param options sizes of the samples and the seed they are drawn with
+/// @return An unordered_map where each key is a medoid and the corresponding
+/// value is the vector of points assigned to that medoid's cluster.
+template <typename T, DistanceFunction<T> Distance>
+inline std::unordered_map<T, std::vector<T>> partitionAroundSampledMedoids(
+    const std::vector<T>& points, const Distance& distanceFunction,
+    const SamplingOptions& options = {}) {
+    std::unordered_map<T, std::vector<T>> clusterMap;
+
+    if (points.empty()) {
+        return clusterMap;
+    }
+
+    const std::size_t sampleSize =
+        std::clamp<std::size_t>(options.sampleSize, 1, points.size());
+
+    // a sample of all the points is the same every time
+    const std::size_t samples =
+        sampleSize == points.size() ? 1
+                                    : std::max<std::size_t>(options.samples, 1);
+
+    std::mt19937_64 random(options.seed);
+    std::vector<std::size_t> order(points.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+
+    // medoids as positions in points
+    std::vector<std::size_t> bestMedoids;
+    std::vector<DistanceScore> bestAssignment;
+    std::uint64_t bestCost = std::numeric_limits<std::uint64_t>::max();
+
+    for (std::size_t s = 0; s < samples; s++) {
+        std::vector<std::size_t> sample = bestMedoids;
+        const std::unordered_set<std::size_t> inSample(sample.begin(),
+                                                       sample.end());
+
+        // partial Fisher-Yates shuffle, the best medoids are not drawn twice
+        for (std::size_t i = 0; sample.size() < sampleSize; i++) {
+            std::uniform_int_distribution<std::size_t> pick(i,
+                                                            order.size() - 1);
+            std::swap(order[i], order[pick(random)]);
+
+            if (!inSample.contains(order[i])) {
+                sample.push_back(order[i]);
+            }
+        }
+
+        std::vector<T> samplePoints;
+        samplePoints.reserve(sample.size());
+
+        for (const auto position : sample) {
+            samplePoints.push_back(points[position]);
+        }
+
+        const DistanceCache<T, Distance> cache(samplePoints, distanceFunction);
+        std::vector<std::uint32_t> indices(samplePoints.size());
+        std::iota(indices.begin(), indices.end(), std::uint32_t{0});
+
+        // medoids as positions in the sample, the best ones are at the front
+        std::vector<std::size_t> medoids(bestMedoids.size());
+        std::iota(medoids.begin(), medoids.end(), std::size_t{0});
+
+        if (medoids.empty()) {
+            for (const auto medoid : anomalousPatternInitialisation(
+                     indices, cache,
+                     [&cache](const std::vector<std::uint32_t>& innerPoints) {
+                         return findCentralMedoid(innerPoints, cache);
+                     })) {
+                medoids.push_back(medoid);
+            }
+        }
+
+        medoids = swapMedoids(indices, std::move(medoids), cache,
+                              options.swapPasses);
+
+        std::vector<T> medoidPoints;
+        std::vector<std::size_t> medoidPositions;
+
+        for (const auto medoid : medoids) {
+            medoidPoints.push_back(samplePoints[medoid]);
+            medoidPositions.push_back(sample[medoid]);
+        }
+
+        auto assignment =
+            assignToNearestMedoids(medoidPoints, points, distanceFunction);
+        std::uint64_t cost = 0;
+
+        for (const auto& nearest : assignment) {
+            cost += static_cast<std::uint64_t>(nearest.distance);
+        }
+
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestMedoids = std::move(medoidPositions);
+            bestAssignment = std::move(assignment);
+        }
+    }
+
+    for (std::size_t i = 0; i < points.size(); i++) {
+        clusterMap[points[bestMedoids[bestAssignment[i].index]]].push_back(
+            points[i]);
+    }
+
+    return clusterMap;
+}
+
+/// @brief Partitions a list of points into a given number of clusters. The
+/// medoids start out spread evenly over the list and are improved with
+/// swapMedoids, with the distances served by a DistanceCache, then every point
+/// joins its nearest medoid
+/// @tparam T Type of the points.
+/// @param points List of points to partition into clusters.
+/// @param clusterCount number of clusters, at most the number of points
+/// @param distanceFunction Function used to calculate the distance between two
+/// points.
+/// @param swapPasses largest number of passes of swapMedoids
+/// @return An unordered_map where each key is a medoid and the corresponding
+/// value is the vector of points assigned to that medoid's cluster.
+template <typename T, DistanceFunction<T> Distance>
+inline std::unordered_map<T, std::vector<T>> partitionIntoMedoids(
+    const std::vector<T>& points, std::size_t clusterCount,
+    const Distance& distanceFunction, std::size_t swapPasses) {
+    std::unordered_map<T, std::vector<T>> clusterMap;
+    clusterCount = std::min(clusterCount, points.size());
+
+    if (clusterCount == 0) {
+        return clusterMap;
+    }
+
+    const DistanceCache<T, Distance> cache(points, distanceFunction);
+    std::vector<std::uint32_t> indices(points.size());
+    std::iota(indices.begin(), indices.end(), std::uint32_t{0});
+
+    std::vector<std::size_t> medoids(clusterCount);
+
+    for (std::size_t m = 0; m < clusterCount; m++) {
+        medoids[m] = m * points.size() / clusterCount;
+    }
+
+    medoids =
+        swapMedoids(indices, std::move(medoids), cache, swapPasses);
+
+    std::vector<std::uint32_t> medoidIndices(medoids.begin(), medoids.end());
+    const auto nearestMedoids =
+        assignToNearestMedoids(medoidIndices, indices, cache);
+
+    for (std::size_t i = 0; i < points.size(); i++) {
+        clusterMap[points[medoids[nearestMedoids[i].index]]].push_back(
+            points[i]);
+    }
+
+    return clusterMap;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef SPELLCHECKER_INDEX_FILE_H
+#define SPELLCHECKER_INDEX_FILE_H
+
+#include <dictionary.h>
+#include <lev_batch.h>
+#include <mapped_file.h>
+#include <spellchecker.h>
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Version of the index file format written by writeIndexFile. Files
+/// with any other version are rejected
+constexpr std::uint32_t indexFileVersion = 5;
+
+/// @brief Fixed-size header at the start of an index file. It is followed by
+/// the arrays of ClusterIndexView in this order: wordOffsets (wordCount + 1
+/// entries), medoids (clusterCount), clusterStarts (clusterCount + 1), members
+/// (wordCount), medoidDistances (wordCount), radii (clusterCount), signatures
+/// (wordCount), the layout of the batch kernels and finally the word blob
+/// (blobSize bytes). The batch layout holds the groups of batchClusterIndex
+/// one after the other: the first block of every group (clusterCount + 2
+/// entries), the blocks (blockCount), their ids (wordCount + clusterCount) and
+/// their characters (charCount bytes), the blocks counting their items and
+/// characters from the start of all of them. The layout is followed by the
+/// lookup table of the words (tableGroupCount groups, see Dictionary). Every
+/// array starts at a multiple of 64 bytes from the start of the file, the
+/// gaps are zeros. All numbers are stored in the byte order of the machine
+/// that wrote the file
+struct IndexFileHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t wordCount;
+    std::uint32_t clusterCount;
+    std::uint32_t blockCount;
+    std::uint64_t blobSize;
+    std::uint64_t charCount;
+    std::uint32_t tableGroupCount;
+    std::uint32_t reserved;
+
+    // FNV-1a hash of everything after the header
+    std::uint64_t checksum;
+};
+
+/// @brief Writes a dictionary and its clusters into an index file. The arrays
+/// of the view are written as they are, the signatures and the batch layout
+/// are calculated if the view has none, and so is the lookup table of the
+/// words. The file is written next to the target and renamed into place, so
+/// processes that have the old file mapped are not affected
+/// @param path path of the index file
+/// @param index words and clusters to write, e.g. ClusterIndex::view
+/// @return 0 on success, -1 if the file could not be written, a word occurs
+/// twice, not every word is in exactly one cluster or the view lacks the
+/// medoid distances or radii
+int writeIndexFile(const std::string& path, const ClusterIndexView& index);
+
+/// @brief Index file mapped into memory read-only. Opening it only validates
+/// the header, checksum and offsets, the words, clusters, signatures, the
+/// blocks of the batch kernels and the lookup table of the words are used in
+/// place
+class IndexFile {
+public:
+    /// @brief Maps and validates the index file at the given path
+    /// @param path path of the index file
+    /// @param error set to the reason of the failure, if any
+    /// @return 0 on success, -1 if the file could not be mapped or is not a
+    /// valid index file
+    int open(const std::string& path, std::string& error);
+
+    /// @return view of the words and clusters stored in the file
+    const ClusterIndexView& view() const { return indexView; }
+
+    /// @brief Looks a word up in the lookup table stored in the file
+    /// @param word word to look up
+    /// @return index of the word, or Dictionary::npos if it is not in the file
+    std::uint32_t find(std::string_view word) const {
+        return Dictionary::find(word, lookupTable, indexView.wordOffsets,
+                                indexView.blob);
+    }
+
+private:
+    MappedFile file;
+    std::unique_ptr<LevBatchWords> batches;
+    std::span<const Dictionary::SlotGroup> lookupTable;
+    ClusterIndexView indexView;
+};
+
+#endif
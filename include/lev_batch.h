@@ -0,0 +1,201 @@
+#ifndef SPELLCHECKER_LEV_BATCH_H
+#define SPELLCHECKER_LEV_BATCH_H
+
+#include <spellchecker.h>
+#include <word_signature.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// @brief Number of words compared to a query at once
+constexpr std::size_t levBatchLanes = 32;
+
+/// @brief Longest query and word the vectorised kernels handle. Distances are
+/// kept in bytes, longer queries fall back to lev word by word
+constexpr std::size_t levBatchMaxLength = 64;
+
+/// @brief Implementations of the batch kernel
+enum class LevBatchKernel {
+    Scalar,
+    Sse2,  // 16 lanes per register, part of every x86-64 CPU
+    Avx2,  // 32 lanes per register
+};
+
+/// @return the fastest kernel the CPU supports, detected once
+LevBatchKernel bestLevBatchKernel();
+
+/// @param kernel a kernel
+/// @return whether the kernel was compiled in and the CPU supports it
+bool isLevBatchKernelSupported(LevBatchKernel kernel);
+
+/// @param kernel a kernel
+/// @return name of the kernel, e.g. "avx2"
+const char* levBatchKernelName(LevBatchKernel kernel);
+
+/// @brief Words laid out for comparing one query against many of them with
+/// the batch kernels. Words are added in groups, and the words of a group are
+/// split by length into blocks of up to levBatchLanes words. A block is
+/// stored transposed: character j of every word comes first, then character
+/// j + 1, so one vector load reads the same position of all its words. Every
+/// group has storage of its own, so one group can be replaced without
+/// touching the others. The blocks only hold offsets into that storage, so a
+/// layout written to a file can also be used in place, see the constructor
+/// taking GroupViews
+class LevBatchWords {
+public:
+    struct Block {
+        std::uint32_t length;     // length of every word in the block
+        std::uint32_t itemCount;  // used lanes, the others are padding
+
+        // position of the first id and of the first character of the block
+        // in the ids and characters of its group
+        std::uint32_t firstItem;
+        std::uint32_t firstChar;
+
+        // character classes of any and of every word in the block, see
+        // WordSignature
+        std::uint32_t anyClasses;
+        std::uint32_t everyClasses;
+    };
+
+    /// @brief Blocks of one group and the storage they point into
+    struct GroupView {
+        std::span<const Block> blocks;
+        const std::uint32_t* ids;  // ids of the words, in lane order
+        const char* chars;         // transposed characters of the words
+
+        auto begin() const { return blocks.begin(); }
+        auto end() const { return blocks.end(); }
+
+        /// @param block a block of the group
+        /// @return ids of the words in the block, in lane order
+        std::span<const std::uint32_t> items(const Block& block) const {
+            return std::span<const std::uint32_t>(ids + block.firstItem,
+                                                  block.itemCount);
+        }
+    };
+
+    LevBatchWords() = default;
+
+    /// @brief Uses groups laid out elsewhere, e.g. in a mapped index file,
+    /// without copying them. They have to outlive the object, and can not be
+    /// replaced or removed
+    /// @param groupViews blocks and storage of every group
+    explicit LevBatchWords(std::vector<GroupView> groupViews)
+        : views(std::move(groupViews)) {}
+
+    // the views point into the storage of their group
+    LevBatchWords(const LevBatchWords&) = delete;
+    LevBatchWords& operator=(const LevBatchWords&) = delete;
+    LevBatchWords(LevBatchWords&&) noexcept = default;
+    LevBatchWords& operator=(LevBatchWords&&) noexcept = default;
+
+    /// @brief Adds a group of words. Blocks keep the order of the words within
+    /// each length and go from the shortest length to the longest, so words
+    /// already sorted by length keep their order
+    /// @param groupIds number given back for each word, e.g. its index in a
+    /// list
+    /// @param words the words, one for each id
+    void addGroup(std::span<const std::uint32_t> groupIds,
+                  std::span<const std::string_view> words);
+
+    /// @brief Replaces the words of a group, laid out as by addGroup
+    /// @param groupIndex index of a group
+    /// @param groupIds number given back for each word
+    /// @param words the words, one for each id
+    void setGroup(std::size_t groupIndex,
+                  std::span<const std::uint32_t> groupIds,
+                  std::span<const std::string_view> words);
+
+    /// @brief Removes a group, the groups after it move down by one
+    /// @param groupIndex index of a group
+    void removeGroup(std::size_t groupIndex);
+
+    /// @return number of groups added
+    std::size_t groupCount() const { return views.size(); }
+
+    /// @param groupIndex index of a group
+    /// @return blocks of the group
+    const GroupView& group(std::size_t groupIndex) const {
+        return views[groupIndex];
+    }
+
+    /// @brief Calculates the levenshtein distance between the query and every
+    /// word of a block
+    /// @param query query word
+    /// @param group group of this object
+    /// @param block block of the group
+    /// @param results set to the distance of the word in each used lane
+    /// @param kernel kernel to use, must be supported
+    static void distances(std::string_view query, const GroupView& group,
+                          const Block& block,
+                          std::array<int, levBatchLanes>& results,
+                          LevBatchKernel kernel = bestLevBatchKernel());
+
+    /// @brief Calculates the levenshtein distance between the query and every
+    /// word of a group
+    /// @param query query word
+    /// @param groupIndex index of a group
+    /// @param results set at the id of every word in the group
+    /// @param kernel kernel to use, must be supported
+    void distances(std::string_view query, std::size_t groupIndex,
+                   std::span<int> results,
+                   LevBatchKernel kernel = bestLevBatchKernel()) const;
+
+    /// @return approximate number of bytes held by the layout
+    std::size_t memoryUsage() const;
+
+private:
+    // the vectors own their buffers, so the views stay valid when a Group is
+    // moved
+    struct Group {
+        std::vector<Block> blocks;
+        std::vector<std::uint32_t> ids;
+        std::vector<char> chars;
+
+        GroupView view() const { return {blocks, ids.data(), chars.data()}; }
+    };
+
+    static Group layOutGroup(std::span<const std::uint32_t> groupIds,
+                             std::span<const std::string_view> words);
+
+    // groups laid out by this object, empty for groups laid out elsewhere
+    std::vector<Group> groups;
+    std::vector<GroupView> views;
+};
+
+/// @param query signature of a query
+/// @param block a block
+/// @return lower bound on the distance between the query and every word of the
+/// block: the classes of the query that no word has, or the classes that every
+/// word has but the query lacks, see classBound
+inline int blockClassBound(const WordSignature& query,
+                           const LevBatchWords::Block& block) {
+    return std::max(std::popcount(query.classes & ~block.anyClasses),
+                    std::popcount(block.everyClasses & ~query.classes));
+}
+
+/// @brief Calculates the levenshtein distance between a query and every word
+/// of a list with the batch kernels
+/// @param query query word
+/// @param words list of words
+/// @return distance to each word, in the order of the list
+std::vector<int> levBatch(std::string_view query,
+                          const std::vector<std::string>& words);
+
+/// @brief Lays out the medoids and clusters of an index for the batch kernels.
+/// Group 0 holds the medoids with the cluster numbers as ids, group c + 1 the
+/// members of cluster c with their word indices as ids
+/// @param index words and clusters
+/// @return the layout, to be set as the batches of the view
+LevBatchWords batchClusterIndex(const ClusterIndexView& index);
+
+#endif
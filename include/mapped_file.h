@@ -0,0 +1,42 @@
+#ifndef SPELLCHECKER_MAPPED_FILE_H
+#define SPELLCHECKER_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/// @brief Read-only memory mapping of a whole file. The pages come straight
+/// from the page cache, so every process mapping the same file shares them
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /// @brief Maps the file at the given path, unmapping any previous one
+    /// @param path path to the file
+    /// @return 0 on success, -1 if the file could not be opened or mapped
+    int open(const std::string& path);
+
+    /// @brief Unmaps the file. Views returned by contents() become invalid
+    void close();
+
+    /// @return contents of the file, empty if no file is mapped
+    std::string_view contents() const { return {data, size}; }
+
+private:
+    const char* data = nullptr;
+    std::size_t size = 0;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef SPELLCHECKER_QUERY_CACHE_H
+#define SPELLCHECKER_QUERY_CACHE_H
+
+#include <spellchecker.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+/// @brief Bounded cache of the suggestions found for a query, safe to use from
+/// several threads. The queries are spread over shards with a lock of their
+/// own. Every shard evicts its least recently used query, but a new query is
+/// only admitted in its place if it was asked for more often (TinyLFU): the
+/// frequencies are estimated by a small count-min sketch that keeps seeing
+/// every query, so a burst of one-off queries can not push the frequent ones
+/// out. Hits and misses are counted in the statistics
+class QueryCache {
+public:
+    /// @param capacity number of queries kept, 0 turns the cache off
+    explicit QueryCache(std::size_t capacity);
+    ~QueryCache();
+
+    QueryCache(const QueryCache&) = delete;
+    QueryCache& operator=(const QueryCache&) = delete;
+
+    /// @brief Looks a query up, and counts it for the admission either way
+    /// @param query a query
+    /// @param suggestions set to the cached suggestions on a hit
+    /// @return whether the query was cached
+    bool find(std::string_view query, std::vector<Suggestion>& suggestions);
+
+    /// @brief Caches the suggestions for a query that find missed, if there is
+    /// room or the query is asked for more often than the one it would evict
+    /// @param query a query
+    /// @param suggestions suggestions found for it
+    void insert(std::string_view query,
+                const std::vector<Suggestion>& suggestions);
+
+    /// @brief Drops every cached query, e.g. after the dictionary changed. The
+    /// frequencies are kept, they describe the queries and not the results
+    void clear();
+
+    /// @return number of cached queries
+    std::size_t size() const;
+
+    /// @return largest number of cached queries
+    std::size_t capacity() const { return totalCapacity; }
+
+private:
+    struct Shard;
+
+    Shard& shardOf(std::uint64_t queryHash) const;
+
+    std::size_t totalCapacity;
+    std::vector<std::unique_ptr<Shard>> shards;
+};
+
+#endif
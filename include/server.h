@@ -0,0 +1,34 @@
+#ifndef SPELLCHECKER_SERVER_H
+#define SPELLCHECKER_SERVER_H
+
+#include <spellchecker.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/// @brief Where a server listens
+struct ServerOptions {
+    std::string socketPath;  // Unix domain socket, used when not empty
+    std::uint16_t port = 0;  // TCP port on 127.0.0.1 otherwise, 0 picks one
+};
+
+/// @brief Serves corrections until SIGINT or SIGTERM. Every line a client
+/// sends is a query, answered with "query<TAB>suggestion,...<TAB>microseconds"
+/// where the time runs from the arrival of the query to its answer. Empty
+/// lines are ignored. Clients may send many queries without waiting: they are
+/// corrected in parallel on the shared thread pool, and the answers on every
+/// connection come back in the order of the queries. A single thread handles
+/// all connections with epoll, so thousands of them cost little more than
+/// their buffers. Only available on Linux
+/// @param options socket to listen on
+/// @param correct function returning the corrections of a query, closest
+/// first. It is called from several threads at once
+/// @return 0 after a clean shutdown, -1 if the socket could not be set up
+int runServer(
+    const ServerOptions& options,
+    const std::function<std::vector<Suggestion>(const std::string&)>& correct);
+
+#endif
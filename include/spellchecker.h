@@ -1,15 +1,125 @@
 #ifndef SPELLCHECKER_SPELLCHECKER_H
 #define SPELLCHECKER_SPELLCHECKER_H
 
+#include <word_signature.h>
+
+#include <cstdint>
+#include <limits>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
-/// @brief Calculates the levenshtein distance between two strings
+/// @brief Word found for a query together with its distance to the query
+struct Suggestion {
+    std::string word;
+    int distance;
+
+    // position of the word in the word list. Lists sorted by frequency, such
+    // as data/20k.txt, make it the frequency rank, so it breaks ties between
+    // words at the same distance
+    std::uint32_t rank;
+};
+
+class LevBatchWords;
+
+/// @brief Read-only view of a dictionary split into clusters. The words are
+/// stored back to back in one blob and the clusters are arrays of word indices,
+/// so the view can point straight into a memory-mapped index file
+struct ClusterIndexView {
+    // word i is blob[wordOffsets[i]..wordOffsets[i + 1])
+    std::string_view blob;
+    std::span<const std::uint32_t> wordOffsets;
+
+    // cluster c is represented by the word medoids[c] and its members are
+    // members[clusterStarts[c]..clusterStarts[c + 1])
+    std::span<const std::uint32_t> medoids;
+    std::span<const std::uint32_t> clusterStarts;
+    std::span<const std::uint32_t> members;
+
+    // optional signature of every word, used to rule out candidates before
+    // their distance is calculated
+    std::span<const WordSignature> signatures;
+
+    // optional distance of every word to the medoid of its cluster, and the
+    // radius of every cluster: no member is further from its medoid. With the
+    // triangle inequality they rule out members and whole clusters
+    std::span<const std::uint32_t> medoidDistances;
+    std::span<const std::uint32_t> radii;
+
+    // optional copy of the medoids and clusters laid out for the batch
+    // kernels, see batchClusterIndex
+    const LevBatchWords* batches = nullptr;
+
+    std::size_t wordCount() const {
+        return wordOffsets.empty() ? 0 : wordOffsets.size() - 1;
+    }
+
+    std::size_t clusterCount() const { return medoids.size(); }
+
+    std::string_view word(std::uint32_t index) const {
+        return blob.substr(wordOffsets[index],
+                           wordOffsets[index + 1] - wordOffsets[index]);
+    }
+
+    std::span<const std::uint32_t> cluster(std::size_t index) const {
+        return members.subspan(clusterStarts[index],
+                               clusterStarts[index + 1] - clusterStarts[index]);
+    }
+};
+
+/// @brief Calculates the levenshtein distance between two strings using the
+/// bit-parallel (Myers/Hyyro) algorithm
+/// @param a first string
+/// @param b second string
+/// @return number of edits needed to turn string a into b
+int lev(std::string_view a, std::string_view b);
+
+/// @brief Calculates the levenshtein distance between two strings by filling
+/// the full dynamic programming matrix. Slow, kept as the reference
+/// implementation that lev is checked against
 /// @param a first string
 /// @param b second string
 /// @return number of edits needed to turn string a into b
-int lev(const std::string& a, const std::string& b);
+int levMatrix(std::string_view a, std::string_view b);
+
+/// @brief Calculates the levenshtein distance between two strings, giving up
+/// as soon as it is known to exceed maxDist. Only a band of 2 * maxDist + 1
+/// diagonals of the matrix is computed
+/// @param a first string
+/// @param b second string
+/// @param maxDist largest distance the caller is interested in
+/// @return number of edits needed to turn string a into b, or maxDist + 1 if
+/// that number exceeds maxDist
+int levBounded(std::string_view a, std::string_view b, int maxDist);
+
+/// @brief Precomputed pattern-match table of a query word for the bit-parallel
+/// levenshtein kernel. Building it once and reusing it makes comparing one
+/// query against many words cost O(n) word operations per comparison
+class LevPattern {
+public:
+    /// @param pattern query word. Words longer than 64 characters are split
+    /// into several 64-bit blocks
+    explicit LevPattern(std::string_view pattern);
+
+    /// @brief Calculates the levenshtein distance between the pattern and a
+    /// word
+    /// @param word word to compare the pattern to
+    /// @return number of edits needed to turn the pattern into word
+    int distance(std::string_view word) const;
+
+    /// @return length of the pattern
+    std::size_t size() const { return patternSize; }
+
+private:
+    std::size_t patternSize;
+    std::size_t blockCount;
+
+    // one bit mask per block for every possible character, laid out as
+    // peq[character * blockCount + block]
+    std::vector<std::uint64_t> peq;
+};
 
 /// @brief calculate the distances from input to each word in the list and map
 /// them
@@ -40,4 +150,34 @@ std::vector<std::string> findClosestCandidates(
     const std::unordered_map<std::string, std::vector<std::string>>&
         clusterMap);
 
+/// @brief Finds the words that are the closest to the input. The clusters are
+/// visited as by suggest, so the result is exact
+/// @param input input word
+/// @param index dictionary split into clusters
+/// @return every word at the smallest distance to the input
+std::vector<std::string> findClosestCandidates(const std::string& input,
+                                               const ClusterIndexView& index);
+
+/// @brief Finds the k words closest to the input, ties going to the lower
+/// rank. The best words so far are kept in a bounded heap during the scan, and
+/// the worst of them bounds the filters and levBounded, so no distance is
+/// calculated twice and the result needs no sorting afterwards.
+///
+/// Clusters are scanned in the order of their medoid's distance to the input.
+/// Every word is in the cluster of its nearest medoid, so a word within bound
+/// of the input has a medoid at most closest + 2 * bound away, where closest
+/// is the distance of the nearest medoid. The scan stops at the first cluster
+/// beyond that, and the result is exact. With the medoid distances and radii
+/// of the view, the triangle inequality also skips every cluster whose medoid
+/// is more than its radius + bound away, and every member whose distance to
+/// the medoid differs from the input's by more than bound
+/// @param input word to find suggestions for
+/// @param index dictionary split into clusters
+/// @param k largest number of suggestions
+/// @param maxDist largest distance a suggestion may have
+/// @return up to k suggestions, closest first
+std::vector<Suggestion> suggest(
+    const std::string& input, const ClusterIndexView& index, std::size_t k,
+    int maxDist = std::numeric_limits<int>::max());
+
 #endif
@@ -0,0 +1,193 @@
+#ifndef SPELLCHECKER_STATS_H
+#define SPELLCHECKER_STATS_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Set to 0 (cmake -DSPELLCHECKER_STATS=OFF) to compile every statistics call
+// in the hot paths down to nothing
+#ifndef SPELLCHECKER_STATS
+#define SPELLCHECKER_STATS 1
+#endif
+
+/// @brief Whether this build collects runtime statistics
+constexpr bool statsEnabled = SPELLCHECKER_STATS != 0;
+
+/// @brief Running totals collected while the program works
+enum class StatCounter {
+    LevCalls,                 // distance calculations
+    LevCells,                 // cells of the DP matrices they stand for
+    ClusteringRounds,         // medoids found by the anomalous pattern search
+    ClusteringRefinements,    // recalculations of a cluster's medoid
+    ClusteringReassignments,  // points that changed cluster in a refinement
+    ClusteringSwaps,          // medoids replaced by swapMedoids
+    CentralMedoidNanoseconds,
+    FurthestElementNanoseconds,
+    SplitNanoseconds,       // two-medoid partitions of the remaining points
+    RefinementNanoseconds,  // new medoid of the furthest cluster and re-split
+    Queries,                // calls of findClosestCandidates
+    CandidatesExamined,     // words compared to the query in them
+    FilterChecks,           // candidates run through the filter cascade
+    FilterLengthRejects,    // ruled out by the length difference
+    FilterClassRejects,     // ruled out by the characters they lack
+    FilterBigramRejects,    // ruled out by the bigrams they lack
+    FilterBagRejects,       // ruled out by the character counts
+    FilterTriangleRejects,  // ruled out by their distance to the medoid
+    FilterSkippedLev,       // distance calculations saved by the filters
+    CacheHits,              // queries answered by the query cache
+    CacheMisses,            // queries the query cache did not hold
+    CacheEvictions,         // queries dropped to make room for another
+    CacheRejections,        // queries not admitted, being asked for too rarely
+};
+
+constexpr std::size_t statCounterCount = 23;
+
+/// @brief Distributions collected while the program works. Values are put into
+/// power-of-two buckets: bucket 0 holds 0, bucket b holds [2^(b-1), 2^b)
+enum class StatHistogram {
+    QueryMicroseconds,
+    CandidatesPerQuery,
+    ReassignmentsPerRefinement,
+    RequestMicroseconds,  // server requests, from arrival to their answer
+};
+
+constexpr std::size_t statHistogramCount = 4;
+constexpr std::size_t statHistogramBuckets = 40;
+
+/// @brief Copy of all the statistics at one point in time
+struct StatsSnapshot {
+    struct Histogram {
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t max = 0;
+        std::array<std::uint64_t, statHistogramBuckets> buckets = {};
+    };
+
+    std::array<std::uint64_t, statCounterCount> counters = {};
+    std::array<Histogram, statHistogramCount> histograms = {};
+};
+
+// Storage of the statistics, only meant to be used by the functions below.
+// Every thread gets a shard of the counters and histograms on cache lines of
+// its own, and statsSnapshot adds the shards up
+struct StatsHistogram {
+    std::atomic<std::uint64_t> count = 0;
+    std::atomic<std::uint64_t> sum = 0;
+    std::atomic<std::uint64_t> max = 0;
+    std::array<std::atomic<std::uint64_t>, statHistogramBuckets> buckets = {};
+};
+
+struct alignas(64) StatsShard {
+    std::array<std::atomic<std::uint64_t>, statCounterCount> counters = {};
+    std::array<StatsHistogram, statHistogramCount> histograms = {};
+};
+
+constexpr std::size_t statsShardCount = 64;
+
+extern std::array<StatsShard, statsShardCount> statsShards;
+
+std::size_t nextStatsShard();
+
+/// @return shard of the calling thread
+inline StatsShard& threadStatsShard() {
+    thread_local const std::size_t shard = nextStatsShard();
+
+    return statsShards[shard];
+}
+
+/// @brief Adds to a counter
+/// @param counter counter to add to
+/// @param value amount to add
+inline void statsAdd(StatCounter counter, std::uint64_t value = 1) {
+    if constexpr (statsEnabled) {
+        threadStatsShard()
+            .counters[static_cast<std::size_t>(counter)]
+            .fetch_add(value, std::memory_order_relaxed);
+    }
+}
+
+/// @brief Adds a value to a histogram
+/// @param histogram histogram to add to
+/// @param value value to add
+inline void statsRecord(StatHistogram histogram, std::uint64_t value) {
+    if constexpr (statsEnabled) {
+        StatsHistogram& target =
+            threadStatsShard().histograms[static_cast<std::size_t>(histogram)];
+        const std::size_t bucket = std::min<std::size_t>(
+            static_cast<std::size_t>(std::bit_width(value)),
+            statHistogramBuckets - 1);
+
+        target.count.fetch_add(1, std::memory_order_relaxed);
+        target.sum.fetch_add(value, std::memory_order_relaxed);
+        target.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+        std::uint64_t max = target.max.load(std::memory_order_relaxed);
+
+        while (value > max && !target.max.compare_exchange_weak(
+                                  max, value, std::memory_order_relaxed)) {
+        }
+    }
+}
+
+/// @brief Adds the time between its creation and destruction to a counter, in
+/// nanoseconds. Does not even read the clock when statistics are disabled
+class StatsTimer {
+public:
+    explicit StatsTimer(StatCounter timeCounter) : counter(timeCounter) {
+        if constexpr (statsEnabled) {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+
+    ~StatsTimer() {
+        if constexpr (statsEnabled) {
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+
+            statsAdd(counter,
+                     static_cast<std::uint64_t>(
+                         std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             elapsed)
+                             .count()));
+        }
+    }
+
+    StatsTimer(const StatsTimer&) = delete;
+    StatsTimer& operator=(const StatsTimer&) = delete;
+
+private:
+    StatCounter counter;
+    std::chrono::steady_clock::time_point start;
+};
+
+/// @return the current value of all statistics. Updates made while the
+/// snapshot is taken may or may not be part of it
+StatsSnapshot statsSnapshot();
+
+/// @brief Sets all statistics back to zero
+void resetStats();
+
+/// @param counter a counter
+/// @return name of the counter as used in the JSON output
+const char* statCounterName(StatCounter counter);
+
+/// @param histogram a histogram
+/// @return name of the histogram as used in the JSON output
+const char* statHistogramName(StatHistogram histogram);
+
+/// @brief Prints the statistics in a human readable form
+/// @param output stream to print to
+/// @param snapshot statistics to print
+void printStats(std::ostream& output, const StatsSnapshot& snapshot);
+
+/// @brief Writes the statistics as a JSON object
+/// @param output stream to write to
+/// @param snapshot statistics to write
+void writeStatsJson(std::ostream& output, const StatsSnapshot& snapshot);
+
+#endif
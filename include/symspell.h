@@ -0,0 +1,69 @@
+#ifndef SPELLCHECKER_SYMSPELL_H
+#define SPELLCHECKER_SYMSPELL_H
+
+#include <dictionary.h>
+#include <spellchecker.h>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// @brief Symmetric-delete index (SymSpell). Every word is stored under all
+/// the strings that can be made from it with up to maxEditDistance deletions.
+/// Two words are within that distance of each other only if they share such a
+/// variant, so a query is answered by generating its own delete variants,
+/// looking them up and verifying the few words found with lev. Variants are
+/// kept as 64-bit hashes with their word indices laid out contiguously
+class SymSpellIndex {
+public:
+    /// @brief Builds the index
+    /// @param words list of unique words to index
+    /// @param maxEditDistance largest distance the index can answer queries
+    /// for. The index grows quickly with it, 1 or 2 are sensible values
+    SymSpellIndex(const Dictionary& words, int maxEditDistance);
+
+    /// @brief Finds all words within a given distance of the query
+    /// @param query word to look up
+    /// @param maxDist largest distance a result may have. Values larger than
+    /// maxEditDistance are capped to it
+    /// @return matching words, ordered by distance to the query
+    std::vector<Suggestion> lookup(const std::string& query,
+                                   int maxDist) const;
+
+    /// @return largest distance the index can answer queries for
+    int maxEditDistance() const { return maxDistance; }
+
+    /// @return time it took to build the index
+    std::chrono::milliseconds buildTime() const { return buildDuration; }
+
+    /// @return approximate number of bytes held by the index, words included
+    std::size_t memoryUsage() const;
+
+    /// @return number of distinct delete variants in the index
+    std::size_t variantCount() const { return variantHashes.size(); }
+
+private:
+    static constexpr std::uint32_t emptySlot = 0xFFFFFFFF;
+
+    // returns the position of the variant in variantHashes, or emptySlot
+    std::uint32_t findVariant(std::uint64_t hash) const;
+
+    int maxDistance;
+    std::chrono::milliseconds buildDuration{0};
+
+    Dictionary words;
+
+    // postings of variantHashes[i] are
+    // postings[postingStarts[i]..postingStarts[i + 1])
+    std::vector<std::uint64_t> variantHashes;
+    std::vector<std::uint32_t> postingStarts;
+    std::vector<std::uint32_t> postings;
+
+    // open addressing table with linear probing, holds positions in
+    // variantHashes
+    std::vector<std::uint32_t> table;
+    std::uint64_t tableMask = 0;
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef SPELLCHECKER_THREAD_POOL_H
+#define SPELLCHECKER_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Fixed set of worker threads with one task queue each. Workers take
+/// tasks from the back of their own queue and steal from the front of the
+/// others' when they run out, so uneven chunks of work still keep every core
+/// busy. The pool is meant to be created once and shared by everything that
+/// runs in parallel, see ThreadPool::shared
+class ThreadPool {
+public:
+    /// @param threadCount number of threads that work on parallel loops, the
+    /// calling thread included. 0 picks std::thread::hardware_concurrency
+    explicit ThreadPool(std::size_t threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// @return number of threads that work on parallel loops, the calling
+    /// thread included
+    std::size_t size() const { return workers.size() + 1; }
+
+    /// @brief Queues a task. Tasks submitted from a worker go to its own
+    /// queue, others are spread over all of them. Runs the task right away if
+    /// the pool has no workers
+    /// @param task task to run
+    void submit(std::function<void()> task);
+
+    /// @brief Process-wide pool used by the clustering templates
+    /// @return the shared pool, created on first use
+    static ThreadPool& shared();
+
+    /// @brief Sets the size of the shared pool. Has no effect once the pool
+    /// has been created by the first call to shared()
+    /// @param threadCount number of threads, 0 picks
+    /// std::thread::hardware_concurrency
+    static void setSharedThreadCount(std::size_t threadCount);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    bool popTask(std::size_t index, std::function<void()>& task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<std::size_t> nextQueue = 0;
+    std::atomic<std::size_t> queuedTasks = 0;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+/// @brief Runs body over the range [0, count) split into chunks, using the
+/// pool's workers and the calling thread. Chunks are claimed dynamically, so
+/// the calling thread never waits for a chunk nobody has started, which also
+/// makes nested calls safe
+/// @param count size of the range
+/// @param minChunk smallest number of items worth sending to another thread
+/// @param body function called as body(begin, end) for each chunk
+/// @param pool pool to run on
+template <typename Body>
+inline void parallelFor(std::size_t count, std::size_t minChunk,
+                        const Body& body,
+                        ThreadPool& pool = ThreadPool::shared()) {
+    if (count == 0) {
+        return;
+    }
+
+    // a few chunks per thread even out the differences in their cost
+    const std::size_t chunkSize = std::max<std::size_t>(
+        {minChunk, 1, (count + pool.size() * 4 - 1) / (pool.size() * 4)});
+    const std::size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    if (chunkCount == 1 || pool.size() == 1) {
+        body(std::size_t{0}, count);
+        return;
+    }
+
+    struct State {
+        std::atomic<std::size_t> nextChunk = 0;
+        std::atomic<std::size_t> doneChunks = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    // helpers that only get to run after the loop is over must still find a
+    // valid state, they then see that no chunk is left and return
+    const auto state = std::make_shared<State>();
+
+    const auto work = [state, &body, count, chunkSize, chunkCount]() {
+        std::size_t chunk;
+
+        while ((chunk = state->nextChunk.fetch_add(1)) < chunkCount) {
+            const std::size_t begin = chunk * chunkSize;
+            body(begin, std::min(count, begin + chunkSize));
+
+            if (state->doneChunks.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->finished.notify_all();
+            }
+        }
+    };
+
+    const std::size_t helpers = std::min(chunkCount, pool.size()) - 1;
+
+    for (std::size_t i = 0; i < helpers; i++) {
+        pool.submit(work);
+    }
+
+    work();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->finished.wait(
+        lock, [&state, chunkCount]() { return state->doneChunks == chunkCount; });
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SPELLCHECKER_TRIE_H
+#define SPELLCHECKER_TRIE_H
+
+#include <dictionary.h>
+#include <spellchecker.h>
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+/// @brief Trie over a list of words, searched like a Levenshtein automaton. A
+/// query walks the trie once, carrying one row of the distance matrix per
+/// depth, so words sharing a prefix share the rows of that prefix instead of
+/// calculating them again in every lev call. The smallest value of a row is a
+/// lower bound on the distance of every word below the node, so subtrees that
+/// can not hold a result are skipped. Nodes are stored in flat arrays in
+/// breadth-first order, the children of a node being one contiguous range
+class Trie {
+public:
+    /// @brief Builds the trie. Takes O(n log n) word comparisons to sort the
+    /// words and then one pass over them
+    /// @param words list of unique words to index
+    explicit Trie(const Dictionary& words);
+
+    /// @brief Finds the k words closest to the query
+    /// @param query word to look up
+    /// @param k number of words to return
+    /// @param maxDist largest distance a result may have
+    /// @return up to k words, ordered by distance to the query
+    std::vector<Suggestion> nearest(
+        const std::string& query, std::size_t k,
+        int maxDist = std::numeric_limits<int>::max()) const;
+
+    /// @return number of nodes in the trie, the root included
+    std::size_t nodeCount() const { return nodes.size(); }
+
+    /// @return approximate number of bytes held by the trie, words included
+    std::size_t memoryUsage() const;
+
+private:
+    // the children of node i are nodes[firstChild..firstChild + childCount),
+    // sorted by their label
+    struct Node {
+        std::uint32_t firstChild;
+        std::uint32_t childCount;
+
+        // position in the original word list of the word ending at the node,
+        // npos if no word ends there
+        std::uint32_t rank;
+    };
+
+    Dictionary words;
+    std::vector<Node> nodes;
+
+    // character leading to node i from its parent, kept apart from the nodes
+    // so the characters of all children are read from one cache line
+    std::vector<char> labels;
+
+    // length of the longest word, which is the depth of the deepest node
+    std::size_t depth = 0;
+};
+
+#endif
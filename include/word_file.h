@@ -0,0 +1,26 @@
+#ifndef SPELLCHECKER_WORD_FILE_H
+#define SPELLCHECKER_WORD_FILE_H
+
+#include <dictionary.h>
+
+#include <cstddef>
+#include <string>
+
+/// @brief Longest word, in bytes, that readWordsFromFile accepts
+constexpr std::size_t maxWordLength = 50;
+
+/// @brief Reads all lines from a file into the dictionary, in file order. The
+/// words are lowercased, and words longer than maxWordLength as well as
+/// duplicates are skipped. Both are reported on stdout and logged to
+/// 'too_long_words.txt' and 'duplicates.txt' in the working directory.
+///
+/// The file is mapped into memory and split into chunks at line breaks. The
+/// chunks are lowercased, checked and hashed on the shared thread pool, and
+/// the words are then added to the dictionary in one pass in file order, so
+/// the result and the messages do not depend on the number of threads
+/// @param words dictionary to be populated
+/// @param filePath path to the file to read from
+/// @return 0 on success, -1 if the file could not be read or held no words
+int readWordsFromFile(Dictionary& words, const std::string& filePath);
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef SPELLCHECKER_WORD_SIGNATURE_H
+#define SPELLCHECKER_WORD_SIGNATURE_H
+
+#include <stats.h>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+/// @brief Number of character classes counted by a signature: the 26 letters,
+/// regardless of case, and one class for every other character
+constexpr std::size_t signatureClasses = 27;
+
+/// @brief Summary of a word from which lower bounds on its levenshtein
+/// distance to other words can be calculated in a few instructions, without
+/// looking at the words themselves. See signaturesExceed
+struct WordSignature {
+    // number of characters of every class, 4 bits each and saturated at 15.
+    // Classes 0-15 are in the first word, 16-26 in the second
+    std::array<std::uint64_t, 2> counts;
+
+    // one bit for every pair of adjacent characters, picked by a hash
+    std::uint64_t bigrams;
+
+    // one bit for every class that occurs in the word
+    std::uint32_t classes;
+
+    // length of the word and sum of the saturated counts, both saturated at
+    // 65535
+    std::uint16_t length;
+    std::uint16_t countTotal;
+};
+
+/// @param word a word
+/// @return signature of the word
+WordSignature wordSignature(std::string_view word);
+
+// Sum of |a - b| over the 8 bytes of two words whose bytes are all <= 15. The
+// bytes are biased by 16 before subtracting so that no borrow crosses a byte
+inline int byteAbsoluteDifferenceSum(std::uint64_t a, std::uint64_t b) {
+    constexpr std::uint64_t ones = 0x0101010101010101ull;
+    constexpr std::uint64_t lowNibbles = 0x0F * ones;
+    constexpr std::uint64_t bias = 0x10 * ones;
+
+    const std::uint64_t aMinusB = (a | bias) - b;  // 16 + a - b
+    const std::uint64_t bMinusA = (b | bias) - a;  // 16 + b - a
+
+    // 0x0F in the bytes where a >= b
+    const std::uint64_t aNotSmaller = ((aMinusB >> 4) & ones) * 0x0F;
+    const std::uint64_t difference =
+        (aMinusB & aNotSmaller) | (bMinusA & ~aNotSmaller & lowNibbles);
+
+    return static_cast<int>((difference * ones) >> 56);
+}
+
+/// @param a signature of a word
+/// @param b signature of another word
+/// @return difference of the lengths of the words
+inline int lengthBound(const WordSignature& a, const WordSignature& b) {
+    return std::abs(static_cast<int>(a.length) - static_cast<int>(b.length));
+}
+
+/// @param a signature of a word
+/// @param b signature of another word
+/// @return number of character classes that occur in one word but not in the
+/// other, whichever word has more. Every one of them costs at least one edit
+inline int classBound(const WordSignature& a, const WordSignature& b) {
+    return std::max(std::popcount(a.classes & ~b.classes),
+                    std::popcount(b.classes & ~a.classes));
+}
+
+/// @param a signature of a word
+/// @param b signature of another word
+/// @return lower bound from the bigrams that occur in one word but not in the
+/// other. One edit changes at most two bigrams
+inline int bigramBound(const WordSignature& a, const WordSignature& b) {
+    const int missing = std::max(std::popcount(a.bigrams & ~b.bigrams),
+                                 std::popcount(b.bigrams & ~a.bigrams));
+
+    return (missing + 1) / 2;
+}
+
+/// @param a signature of a word
+/// @param b signature of another word
+/// @return bag distance of the character class counts, the larger of the
+/// number of characters one word has in excess of the other and vice versa
+inline int bagBound(const WordSignature& a, const WordSignature& b) {
+    constexpr std::uint64_t lowNibbles = 0x0F0F0F0F0F0F0F0Full;
+
+    int absoluteDifference = 0;
+
+    for (std::size_t i = 0; i < a.counts.size(); i++) {
+        absoluteDifference += byteAbsoluteDifferenceSum(
+            a.counts[i] & lowNibbles, b.counts[i] & lowNibbles);
+        absoluteDifference += byteAbsoluteDifferenceSum(
+            (a.counts[i] >> 4) & lowNibbles, (b.counts[i] >> 4) & lowNibbles);
+    }
+
+    // max(excess, shortfall) = (|excess| + |shortfall| + |excess - shortfall|)
+    // / 2, and excess - shortfall is the difference of the totals
+    const int totalDifference = std::abs(static_cast<int>(a.countTotal) -
+                                         static_cast<int>(b.countTotal));
+
+    return (absoluteDifference + totalDifference) / 2;
+}
+
+/// @brief Runs the filter cascade: the cheap lower bounds on the levenshtein
+/// distance of two words are checked in order of their cost until one of them
+/// exceeds maxDist. Every check and rejection is counted in the statistics
+/// @param query signature of the query word
+/// @param word signature of the candidate word
+/// @param maxDist largest distance the caller is interested in
+/// @return true if the distance of the words is known to exceed maxDist,
+/// false if it has to be calculated
+inline bool signaturesExceed(const WordSignature& query,
+                             const WordSignature& word, int maxDist) {
+    statsAdd(StatCounter::FilterChecks);
+
+    if (lengthBound(query, word) > maxDist) {
+        statsAdd(StatCounter::FilterLengthRejects);
+        return true;
+    }
+
+    if (classBound(query, word) > maxDist) {
+        statsAdd(StatCounter::FilterClassRejects);
+        return true;
+    }
+
+    if (bigramBound(query, word) > maxDist) {
+        statsAdd(StatCounter::FilterBigramRejects);
+        return true;
+    }
+
+    if (bagBound(query, word) > maxDist) {
+        statsAdd(StatCounter::FilterBagRejects);
+        return true;
+    }
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,747 @@
+#include <bktree.h>
+#include <cluster_tree.h>
+#include <clustering.h>
+#include <dictionary.h>
+#include <distance_cache.h>
+#include <lev_batch.h>
+#include <spellchecker.h>
+#include <symspell.h>
+#include <thread_pool.h>
+#include <trie.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <span>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/// @brief Settings of a benchmark run, see printUsage
+struct BenchOptions {
+    std::string dataDirectory = "data";
+    std::string outputPath;
+    std::size_t maxWords = 5000;
+    std::size_t queryCount = 1000;
+    std::uint32_t seed = 42;
+};
+
+/// @brief Number of distance calculations, spread over several cache lines so
+/// the threads of the pool do not fight over one counter
+class CallCounter {
+public:
+    void add() {
+        thread_local const std::size_t shard =
+            std::hash<std::thread::id>()(std::this_thread::get_id()) %
+            shardCount;
+
+        counters[shard].calls.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::uint64_t total() const {
+        std::uint64_t sum = 0;
+
+        for (const auto& counter : counters) {
+            sum += counter.calls.load(std::memory_order_relaxed);
+        }
+
+        return sum;
+    }
+
+private:
+    static constexpr std::size_t shardCount = 64;
+
+    struct alignas(64) Counter {
+        std::atomic<std::uint64_t> calls = 0;
+    };
+
+    std::array<Counter, shardCount> counters;
+};
+
+/// @brief lev that counts its calls, on words or on indices into a dictionary.
+/// On indices it is DictionaryDistance, bounded calls included. Copies share
+/// the counter, the clustering templates and the distance cache are free to
+/// copy it
+struct CountingLev {
+    CallCounter* counter;
+    const Dictionary* dictionary = nullptr;
+
+    int operator()(const std::string& a, const std::string& b) const {
+        counter->add();
+        return lev(a, b);
+    }
+
+    int operator()(std::uint32_t a, std::uint32_t b) const {
+        counter->add();
+        return DictionaryDistance{dictionary}(a, b);
+    }
+
+    int operator()(std::uint32_t a, std::uint32_t b, int maxDist) const {
+        counter->add();
+        return DictionaryDistance{dictionary}(a, b, maxDist);
+    }
+};
+
+int parseOptions(BenchOptions& options, std::span<char*> args);
+void printUsage();
+std::vector<std::string> readWords(const std::filesystem::path& path);
+std::vector<std::string> makeQueries(const std::vector<std::string>& words,
+                                     std::size_t count, std::uint32_t seed);
+std::string jsonString(const std::string& value);
+void benchmarkLev(std::ostream& json, const std::vector<std::string>& words,
+                  std::uint32_t seed);
+void benchmarkLookup(std::ostream& json, const std::vector<std::string>& words,
+                     const std::vector<std::string>& queries,
+                     const Dictionary& dictionary);
+std::uint64_t clusteringCost(
+    const std::unordered_map<std::uint32_t, std::vector<std::uint32_t>>&
+        clusters,
+    const Dictionary& dictionary);
+ClusterIndex benchmarkClustering(std::ostream& json,
+                                 const std::vector<std::string>& words,
+                                 Dictionary dictionary);
+void benchmarkQueries(
+    std::ostream& json, const std::string& engine,
+    const std::vector<std::string>& queries,
+    const std::function<std::vector<std::string>(const std::string&)>&
+        findCandidates);
+
+int main(int argc, char* argv[]) {
+    const std::span<char*> args(argv, static_cast<std::size_t>(argc));
+
+    BenchOptions options;
+
+    if (parseOptions(options, args) != 0) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::filesystem::path> files;
+    std::error_code error;
+
+    for (const auto& entry :
+         std::filesystem::directory_iterator(options.dataDirectory, error)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".txt") {
+            files.push_back(entry.path());
+        }
+    }
+
+    if (error || files.empty()) {
+        std::cerr << "No .txt files found in " << options.dataDirectory
+                  << "\n";
+        return 1;
+    }
+
+    std::sort(files.begin(), files.end());
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n"
+         << "  \"seed\": " << options.seed << ",\n"
+         << "  \"threads\": " << ThreadPool::shared().size() << ",\n"
+         << "  \"max_words\": " << options.maxWords << ",\n"
+         << "  \"files\": [";
+
+    for (std::size_t i = 0; i < files.size(); i++) {
+        std::vector<std::string> words = readWords(files[i]);
+
+        // the first words of the frequency-sorted lists are the common ones
+        if (options.maxWords != 0 && words.size() > options.maxWords) {
+            words.resize(options.maxWords);
+        }
+
+        std::cerr << "Benchmarking " << files[i].string() << " ("
+                  << words.size() << " words)" << "... " << std::flush;
+
+        json << (i == 0 ? "\n" : ",\n") << "    {\n"
+             << "      \"file\": " << jsonString(files[i].string()) << ",\n"
+             << "      \"words\": " << words.size() << ",\n";
+
+        if (words.empty()) {
+            json << "      \"skipped\": true\n    }";
+            std::cerr << "Empty, skipped" << "\n";
+            continue;
+        }
+
+        benchmarkLev(json, words, options.seed);
+        json << ",\n";
+
+        Dictionary dictionary;
+
+        for (const auto& word : words) {
+            dictionary.insert(word);
+        }
+
+        const auto queries =
+            makeQueries(words, options.queryCount, options.seed);
+
+        benchmarkLookup(json, words, queries, dictionary);
+        json << ",\n";
+
+        const ClusterIndex clusterIndex =
+            benchmarkClustering(json, words, dictionary);
+        json << ",\n";
+
+        json << "      \"queries\": {\n"
+             << "        \"count\": " << queries.size() << ",\n";
+
+        benchmarkQueries(json, "pam", queries,
+                         [&clusterIndex](const std::string& query) {
+                             return findClosestCandidates(query,
+                                                          clusterIndex.view());
+                         });
+        json << ",\n";
+
+        const BKTree tree(dictionary);
+        benchmarkQueries(json, "bktree", queries,
+                         [&tree](const std::string& query) {
+                             std::vector<std::string> closest;
+
+                             for (const auto& suggestion :
+                                  tree.nearest(query, 1)) {
+                                 closest.push_back(suggestion.word);
+                             }
+
+                             return closest;
+                         });
+        json << ",\n";
+
+        const SymSpellIndex index(dictionary, 2);
+        benchmarkQueries(json, "symspell", queries,
+                         [&index](const std::string& query) {
+                             std::vector<std::string> closest;
+
+                             for (const auto& suggestion :
+                                  index.lookup(query, 2)) {
+                                 closest.push_back(suggestion.word);
+                             }
+
+                             return closest;
+                         });
+        json << ",\n";
+
+        const ClusterTree clusterTree(dictionary, ClusterTreeOptions{});
+        benchmarkQueries(json, "tree", queries,
+                         [&clusterTree](const std::string& query) {
+                             std::vector<std::string> closest;
+
+                             for (const auto& suggestion :
+                                  clusterTree.nearest(query, 1)) {
+                                 closest.push_back(suggestion.word);
+                             }
+
+                             return closest;
+                         });
+        json << ",\n";
+
+        const Trie trie(dictionary);
+        benchmarkQueries(json, "trie", queries,
+                         [&trie](const std::string& query) {
+                             std::vector<std::string> closest;
+
+                             for (const auto& suggestion :
+                                  trie.nearest(query, 1)) {
+                                 closest.push_back(suggestion.word);
+                             }
+
+                             return closest;
+                         });
+        json << "\n      }\n    }";
+
+        std::cerr << "Done!" << "\n";
+    }
+
+    json << "\n  ]\n}\n";
+
+    if (options.outputPath.empty()) {
+        std::cout << json.str();
+        return 0;
+    }
+
+    std::ofstream output(options.outputPath);
+
+    if (!output.is_open()) {
+        std::cerr << "File at " << options.outputPath
+                  << " could not be opened" << "\n";
+        return 1;
+    }
+
+    output << json.str();
+
+    return 0;
+}
+
+/// @brief Reads the command line options
+/// @param options options to be set
+/// @param args command line arguments
+/// @return 0 on success, -1 if an option is not known or has a bad value
+int parseOptions(BenchOptions& options, std::span<char*> args) {
+    for (std::size_t i = 1; i < args.size(); i++) {
+        const std::string arg = args[i];
+        const std::size_t separator = arg.find('=');
+
+        if (separator == std::string::npos) {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return -1;
+        }
+
+        const std::string name = arg.substr(0, separator);
+        const std::string value = arg.substr(separator + 1);
+
+        if (name == "--data") {
+            options.dataDirectory = value;
+            continue;
+        }
+
+        if (name == "--output") {
+            options.outputPath = value;
+            continue;
+        }
+
+        if (value.empty() ||
+            !std::ranges::all_of(value, [](unsigned char c) {
+                return std::isdigit(c) != 0;
+            })) {
+            std::cerr << name << " expects a number\n";
+            return -1;
+        }
+
+        const unsigned long number = std::stoul(value);
+
+        if (name == "--max-words") {
+            options.maxWords = number;
+        } else if (name == "--queries") {
+            options.queryCount = number;
+        } else if (name == "--seed") {
+            options.seed = static_cast<std::uint32_t>(number);
+        } else if (name == "--threads") {
+            ThreadPool::setSharedThreadCount(number);
+        } else {
+            std::cerr << "Unknown argument " << arg << "\n";
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void printUsage() {
+    std::cerr << "Usage: Spellchecker_bench [options]" << "\n" << "\n";
+    std::cerr << "--data=<dir> - directory with the word lists, every .txt "
+                 "file in it is benchmarked (default: data)"
+              << "\n";
+    std::cerr << "--output=<file> - write the JSON report to a file instead "
+                 "of stdout"
+              << "\n";
+    std::cerr << "--max-words=<n> - only use the first n words of each file, "
+                 "0 for all of them (default: 5000)"
+              << "\n";
+    std::cerr << "--queries=<n> - number of queries per engine (default: 1000)"
+              << "\n";
+    std::cerr << "--seed=<n> - seed of the generated queries (default: 42)"
+              << "\n";
+    std::cerr << "--threads=<n> - size of the thread pool, 0 for one thread "
+                 "per core (default: 0)"
+              << "\n";
+}
+
+/// @brief Reads a word list the same way the spellchecker does (lowercased,
+/// duplicates and words longer than 50 characters skipped), keeping the order
+/// of the file
+/// @param path path to the word list
+/// @return list of words
+std::vector<std::string> readWords(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::vector<std::string> words;
+    std::unordered_set<std::string> loadedWords;
+    std::string line;
+
+    while (getline(file, line)) {
+        if (line.ends_with('\r')) {
+            line.pop_back();
+        }
+
+        if (line.size() > 50) {
+            continue;
+        }
+
+        std::transform(line.begin(), line.end(), line.begin(),
+                       [](unsigned char c) {
+                           return static_cast<char>(std::tolower(c));
+                       });
+
+        if (loadedWords.insert(line).second) {
+            words.push_back(line);
+        }
+    }
+
+    return words;
+}
+
+/// @brief Makes misspelled queries by applying one or two random edits to
+/// random words of the dictionary
+/// @param words list of words
+/// @param count number of queries
+/// @param seed seed of the random number generator
+/// @return list of queries, the same for the same seed and words
+std::vector<std::string> makeQueries(const std::vector<std::string>& words,
+                                     std::size_t count, std::uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<std::size_t> pickWord(0, words.size() - 1);
+    std::uniform_int_distribution<int> pickLetter('a', 'z');
+    std::uniform_int_distribution<int> pickEdit(0, 2);
+    std::uniform_int_distribution<int> pickEditCount(1, 2);
+
+    std::vector<std::string> queries;
+    queries.reserve(count);
+
+    for (std::size_t i = 0; i < count; i++) {
+        std::string query = words[pickWord(random)];
+        const int edits = pickEditCount(random);
+
+        for (int edit = 0; edit < edits; edit++) {
+            std::uniform_int_distribution<std::size_t> pickPosition(
+                0, query.size());
+            const std::size_t position = pickPosition(random);
+            const char letter = static_cast<char>(pickLetter(random));
+            const int kind = pickEdit(random);
+
+            if (kind == 0 || query.empty()) {
+                query.insert(position, 1, letter);
+            } else if (kind == 1) {
+                query.erase(std::min(position, query.size() - 1), 1);
+            } else {
+                query[std::min(position, query.size() - 1)] = letter;
+            }
+        }
+
+        queries.push_back(query);
+    }
+
+    return queries;
+}
+
+std::string jsonString(const std::string& value) {
+    std::string escaped = "\"";
+
+    for (const char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+
+        escaped += c;
+    }
+
+    return escaped + "\"";
+}
+
+/// @brief Measures lev for pairs of words whose first word falls into each
+/// length bucket
+void benchmarkLev(std::ostream& json, const std::vector<std::string>& words,
+                  std::uint32_t seed) {
+    struct Bucket {
+        const char* name;
+        std::size_t minLength;
+        std::size_t maxLength;
+    };
+
+    const std::array<Bucket, 5> buckets = {{{"1-4", 1, 4},
+                                            {"5-8", 5, 8},
+                                            {"9-12", 9, 12},
+                                            {"13-16", 13, 16},
+                                            {"17+", 17, 50}}};
+    const std::size_t callsPerBucket = 200000;
+    const std::size_t batchQueriesPerBucket = 200;
+
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<std::size_t> pickWord(0, words.size() - 1);
+
+    // the whole list in the layout of the batch kernels, every batch query is
+    // compared to all of it
+    std::vector<std::uint32_t> ids(words.size());
+    std::vector<std::string_view> wordViews(words.begin(), words.end());
+
+    for (std::size_t i = 0; i < ids.size(); i++) {
+        ids[i] = static_cast<std::uint32_t>(i);
+    }
+
+    LevBatchWords batch;
+    batch.addGroup(ids, wordViews);
+
+    json << "      \"lev_batch_kernel\": \""
+         << levBatchKernelName(bestLevBatchKernel()) << "\",\n"
+         << "      \"lev\": [";
+
+    for (std::size_t b = 0; b < buckets.size(); b++) {
+        std::vector<const std::string*> bucketWords;
+
+        for (const auto& word : words) {
+            if (word.size() >= buckets[b].minLength &&
+                word.size() <= buckets[b].maxLength) {
+                bucketWords.push_back(&word);
+            }
+        }
+
+        json << (b == 0 ? "\n" : ",\n") << "        {\"bucket\": \""
+             << buckets[b].name << "\", ";
+
+        if (bucketWords.empty()) {
+            json << "\"calls\": 0}";
+            continue;
+        }
+
+        std::uniform_int_distribution<std::size_t> pickBucketWord(
+            0, bucketWords.size() - 1);
+        std::vector<std::pair<const std::string*, const std::string*>> pairs;
+        pairs.reserve(callsPerBucket);
+
+        for (std::size_t i = 0; i < callsPerBucket; i++) {
+            pairs.emplace_back(bucketWords[pickBucketWord(random)],
+                               &words[pickWord(random)]);
+        }
+
+        // the sum keeps the compiler from dropping the calls
+        long long checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+
+        for (const auto& [a, other] : pairs) {
+            checksum += lev(*a, *other);
+        }
+
+        const auto stop = std::chrono::steady_clock::now();
+        const double nanoseconds =
+            std::chrono::duration<double, std::nano>(stop - start).count();
+
+        json << "\"calls\": " << callsPerBucket << ", \"ns_per_call\": "
+             << nanoseconds / static_cast<double>(callsPerBucket)
+             << ", \"checksum\": " << checksum << ", ";
+
+        // the batch results are checked against lev afterwards, which doubles
+        // as a randomised equivalence test of the kernel
+        std::vector<std::vector<int>> batchDistances(
+            batchQueriesPerBucket, std::vector<int>(words.size()));
+        const auto batchStart = std::chrono::steady_clock::now();
+
+        for (std::size_t i = 0; i < batchQueriesPerBucket; i++) {
+            batch.distances(*pairs[i].first, 0, batchDistances[i]);
+        }
+
+        const auto batchStop = std::chrono::steady_clock::now();
+        const double batchNanoseconds =
+            std::chrono::duration<double, std::nano>(batchStop - batchStart)
+                .count();
+        std::size_t mismatches = 0;
+
+        for (std::size_t i = 0; i < batchQueriesPerBucket; i++) {
+            for (std::size_t w = 0; w < words.size(); w++) {
+                mismatches += batchDistances[i][w] != lev(*pairs[i].first,
+                                                          words[w]);
+            }
+        }
+
+        json << "\"batch_calls\": " << batchQueriesPerBucket * words.size()
+             << ", \"batch_ns_per_call\": "
+             << batchNanoseconds / static_cast<double>(batchQueriesPerBucket *
+                                                       words.size())
+             << ", \"batch_mismatches\": " << mismatches << "}";
+    }
+
+    json << "\n      ]";
+}
+
+/// @brief Measures the exact-match lookup of the dictionary, for its own
+/// words and for the queries, which are mostly not words
+void benchmarkLookup(std::ostream& json, const std::vector<std::string>& words,
+                     const std::vector<std::string>& queries,
+                     const Dictionary& dictionary) {
+    // found is set to the number of lookups that are words
+    const auto nanosecondsPerLookup =
+        [&dictionary](const std::vector<std::string>& lookups,
+                      std::size_t& found) {
+            std::size_t foundInAllRounds = 0;
+            const std::size_t rounds =
+                std::max<std::size_t>(1000000 / std::max<std::size_t>(
+                                                    lookups.size(), 1),
+                                      1);
+            const auto start = std::chrono::steady_clock::now();
+
+            for (std::size_t round = 0; round < rounds; round++) {
+                for (const auto& lookup : lookups) {
+                    foundInAllRounds +=
+                        dictionary.find(lookup) != Dictionary::npos;
+                }
+            }
+
+            const auto stop = std::chrono::steady_clock::now();
+            found = foundInAllRounds / rounds;
+
+            return std::chrono::duration<double, std::nano>(stop - start)
+                       .count() /
+                   static_cast<double>(rounds * lookups.size());
+        };
+
+    std::size_t wordsFound = 0;
+    std::size_t queriesFound = 0;
+    const double wordNanoseconds = nanosecondsPerLookup(words, wordsFound);
+    const double queryNanoseconds =
+        nanosecondsPerLookup(queries, queriesFound);
+
+    json << "      \"lookup\": {\"word_ns\": " << wordNanoseconds
+         << ", \"query_ns\": " << queryNanoseconds
+         << ", \"words_found\": " << wordsFound
+         << ", \"queries_found\": " << queriesFound << "}";
+}
+
+/// @brief Sums the distances of the words to the medoids of their clusters,
+/// the quantity the clusterings try to keep small
+std::uint64_t clusteringCost(
+    const std::unordered_map<std::uint32_t, std::vector<std::uint32_t>>&
+        clusters,
+    const Dictionary& dictionary) {
+    std::uint64_t cost = 0;
+
+    for (const auto& [medoid, members] : clusters) {
+        for (const auto member : members) {
+            cost += static_cast<std::uint64_t>(
+                DictionaryDistance{&dictionary}(medoid, member));
+        }
+    }
+
+    return cost;
+}
+
+/// @brief Measures the medoid search and the clustering, on copied words
+/// without the distance cache and the way clusterDictionary does it
+/// @return clusters found the way clusterDictionary does it, used by the query
+/// benchmark
+ClusterIndex benchmarkClustering(std::ostream& json,
+                                 const std::vector<std::string>& words,
+                                 Dictionary dictionary) {
+    json << "      \"clustering\": {\n";
+
+    {
+        CallCounter counter;
+        const CountingLev distance{&counter};
+        const auto start = std::chrono::steady_clock::now();
+        const std::string medoid = findCentralMedoid(words, distance);
+        const auto stop = std::chrono::steady_clock::now();
+
+        json << "        \"findCentralMedoid\": {\"ms\": "
+             << std::chrono::duration<double, std::milli>(stop - start).count()
+             << ", \"distance_calls\": " << counter.total()
+             << ", \"medoid\": " << jsonString(medoid) << "},\n";
+    }
+
+    {
+        CallCounter counter;
+        const CountingLev distance{&counter};
+        const auto start = std::chrono::steady_clock::now();
+        const auto clusterMap = partitionAroundMedoids(words, distance);
+        const auto stop = std::chrono::steady_clock::now();
+
+        json << "        \"partitionAroundMedoids\": {\"ms\": "
+             << std::chrono::duration<double, std::milli>(stop - start).count()
+             << ", \"distance_calls\": " << counter.total()
+             << ", \"clusters\": " << clusterMap.size() << "},\n";
+    }
+
+    std::vector<std::uint32_t> indices(dictionary.size());
+
+    for (std::size_t i = 0; i < indices.size(); i++) {
+        indices[i] = static_cast<std::uint32_t>(i);
+    }
+
+    {
+        CallCounter counter;
+        const CountingLev distance{&counter, &dictionary};
+        const auto start = std::chrono::steady_clock::now();
+        const auto clusters =
+            partitionAroundSampledMedoids(indices, distance, SamplingOptions{});
+        const auto stop = std::chrono::steady_clock::now();
+
+        json << "        \"partitionAroundSampledMedoids\": {\"ms\": "
+             << std::chrono::duration<double, std::milli>(stop - start).count()
+             << ", \"distance_calls\": " << counter.total()
+             << ", \"clusters\": " << clusters.size()
+             << ", \"cost\": " << clusteringCost(clusters, dictionary)
+             << "},\n";
+    }
+
+    CallCounter counter;
+    const CountingLev distance{&counter, &dictionary};
+    const auto start = std::chrono::steady_clock::now();
+    const auto clusters = partitionAroundMedoidsCached(indices, distance);
+    ClusterIndex clusterIndex(std::move(dictionary), clusters);
+    const auto stop = std::chrono::steady_clock::now();
+
+    json << "        \"clusterDictionary\": {\"ms\": "
+         << std::chrono::duration<double, std::milli>(stop - start).count()
+         << ", \"distance_calls\": " << counter.total()
+         << ", \"clusters\": " << clusterIndex.view().clusterCount()
+         << ", \"cost\": "
+         << clusteringCost(clusters, clusterIndex.dictionary())
+         << ", \"memory_bytes\": " << clusterIndex.memoryUsage() << "}\n"
+         << "      }";
+
+    return clusterIndex;
+}
+
+/// @brief Measures the latency of every query and reports its percentiles
+void benchmarkQueries(
+    std::ostream& json, const std::string& engine,
+    const std::vector<std::string>& queries,
+    const std::function<std::vector<std::string>(const std::string&)>&
+        findCandidates) {
+    std::vector<double> latencies;
+    latencies.reserve(queries.size());
+
+    std::size_t suggestions = 0;
+
+    for (const auto& query : queries) {
+        const auto start = std::chrono::steady_clock::now();
+        suggestions += findCandidates(query).size();
+        const auto stop = std::chrono::steady_clock::now();
+
+        latencies.push_back(
+            std::chrono::duration<double, std::micro>(stop - start).count());
+    }
+
+    std::sort(latencies.begin(), latencies.end());
+
+    const auto percentile = [&latencies](double fraction) {
+        if (latencies.empty()) {
+            return 0.0;
+        }
+
+        const auto rank = static_cast<std::size_t>(
+            fraction * static_cast<double>(latencies.size() - 1));
+        return latencies[rank];
+    };
+
+    double total = 0;
+
+    for (const double latency : latencies) {
+        total += latency;
+    }
+
+    const double mean =
+        latencies.empty() ? 0.0 : total / static_cast<double>(latencies.size());
+
+    json << "        " << jsonString(engine) << ": {\"mean_us\": " << mean
+         << ", \"p50_us\": " << percentile(0.5)
+         << ", \"p99_us\": " << percentile(0.99)
+         << ", \"p999_us\": " << percentile(0.999)
+         << ", \"suggestions\": " << suggestions << "}";
+}
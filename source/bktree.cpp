@@ -0,0 +1,186 @@
+#include "../include/bktree.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+
+namespace {
+
+bool isCloser(const Suggestion& a, const Suggestion& b) {
+    return a.distance < b.distance ||
+           (a.distance == b.distance && a.rank < b.rank);
+}
+
+}  // namespace
+
+BKTree::BKTree(const Dictionary& wordList) {
+    if (wordList.empty()) {
+        return;
+    }
+
+    // the tree is first grown with a child list per inserted word...
+    std::vector<std::vector<Edge>> children(wordList.size());
+
+    for (std::uint32_t i = 1; i < wordList.size(); i++) {
+        std::uint32_t current = 0;
+
+        while (true) {
+            const int distance = lev(wordList[current], wordList[i]);
+
+            // duplicates are not stored twice
+            if (distance == 0) {
+                break;
+            }
+
+            auto& list = children[current];
+            const auto edge = std::find_if(
+                list.begin(), list.end(),
+                [distance](const Edge& e) { return e.distance == distance; });
+
+            if (edge == list.end()) {
+                list.push_back({distance, static_cast<std::uint32_t>(i)});
+                break;
+            }
+
+            current = edge->child;
+        }
+    }
+
+    // ...and then laid out breadth-first, so that node i is words[i] and the
+    // children of a node occupy one contiguous range of edges
+    std::vector<std::size_t> order = {0};
+
+    for (std::size_t position = 0; position < order.size(); position++) {
+        auto& list = children[order[position]];
+
+        std::sort(list.begin(), list.end(), [](const Edge& a, const Edge& b) {
+            return a.distance < b.distance;
+        });
+
+        nodes.push_back({static_cast<std::uint32_t>(edges.size()),
+                         static_cast<std::uint32_t>(list.size())});
+
+        for (const auto& edge : list) {
+            edges.push_back(
+                {edge.distance, static_cast<std::uint32_t>(order.size())});
+            order.push_back(edge.child);
+        }
+    }
+
+    words.reserve(order.size(), wordList.bytes().size());
+    ranks.reserve(order.size());
+
+    for (const auto index : order) {
+        words.insert(wordList[static_cast<std::uint32_t>(index)]);
+        ranks.push_back(static_cast<std::uint32_t>(index));
+    }
+}
+
+std::vector<Suggestion> BKTree::search(const std::string& query,
+                                       int maxDist) const {
+    std::vector<Suggestion> results;
+
+    if (nodes.empty() || maxDist < 0) {
+        return results;
+    }
+
+    const LevPattern pattern(query);
+    std::vector<std::uint32_t> pending = {0};
+
+    while (!pending.empty()) {
+        const std::uint32_t node = pending.back();
+        pending.pop_back();
+
+        const int distance = pattern.distance(words[node]);
+
+        if (distance <= maxDist) {
+            results.push_back(
+                {std::string(words[node]), distance, ranks[node]});
+        }
+
+        // by the triangle inequality only children whose edge distance is
+        // within maxDist of our distance can hold a match
+        const auto first = edges.begin() + nodes[node].firstEdge;
+        const auto last = first + nodes[node].edgeCount;
+        auto it = std::lower_bound(
+            first, last, distance - maxDist,
+            [](const Edge& e, int value) { return e.distance < value; });
+
+        for (; it != last && it->distance <= distance + maxDist; ++it) {
+            pending.push_back(it->child);
+        }
+    }
+
+    std::sort(results.begin(), results.end(), isCloser);
+
+    return results;
+}
+
+std::vector<Suggestion> BKTree::nearest(const std::string& query,
+                                        std::size_t k, int maxDist) const {
+    // max-heap on distance, the front is the worst of the k best so far
+    std::vector<Suggestion> best;
+
+    if (nodes.empty() || k == 0 || maxDist < 0) {
+        return best;
+    }
+
+    struct Pending {
+        std::uint32_t node;
+        int lowerBound;
+    };
+
+    const LevPattern pattern(query);
+    std::vector<Pending> pending = {{0, 0}};
+    int radius = maxDist;
+
+    while (!pending.empty()) {
+        const Pending current = pending.back();
+        pending.pop_back();
+
+        // the radius may have shrunk since the node was queued
+        if (current.lowerBound > radius) {
+            continue;
+        }
+
+        const int distance = pattern.distance(words[current.node]);
+        const Suggestion candidate = {std::string(words[current.node]),
+                                      distance, ranks[current.node]};
+
+        // a word too far away to be a result may still have close children
+        if (distance <= maxDist && best.size() < k) {
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end(), isCloser);
+        } else if (distance <= maxDist && isCloser(candidate, best.front())) {
+            std::pop_heap(best.begin(), best.end(), isCloser);
+            best.back() = candidate;
+            std::push_heap(best.begin(), best.end(), isCloser);
+        }
+
+        if (best.size() == k) {
+            radius = std::min(radius, best.front().distance);
+        }
+
+        const Node& node = nodes[current.node];
+        const std::size_t queued = pending.size();
+
+        for (std::uint32_t i = 0; i < node.edgeCount; i++) {
+            const Edge& edge = edges[node.firstEdge + i];
+            const int lowerBound = std::abs(edge.distance - distance);
+
+            if (lowerBound <= radius) {
+                pending.push_back({edge.child, lowerBound});
+            }
+        }
+
+        // visit the most promising children first so the radius shrinks early
+        std::sort(pending.begin() + static_cast<std::ptrdiff_t>(queued),
+                  pending.end(), [](const Pending& a, const Pending& b) {
+                      return a.lowerBound > b.lowerBound;
+                  });
+    }
+
+    std::sort_heap(best.begin(), best.end(), isCloser);
+
+    return best;
+}
@@ -0,0 +1,426 @@
+#include "../include/check_file.h"
+
+#include "../include/bounded_queue.h"
+#include "../include/thread_pool.h"
+#include "../include/word_file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// a chunk of the text, cut after its last separator
+struct Chunk {
+    std::size_t sequence = 0;
+    std::uint64_t offset = 0;
+    std::string text;
+};
+
+// some of the unknown tokens of a chunk, every chunk sends at least one
+// part, even without unknown tokens, so the writer can move past it
+struct TokenBatch {
+    std::size_t chunk = 0;
+    std::size_t part = 0;
+    std::size_t partCount = 0;
+    std::vector<std::pair<std::uint64_t, std::string>> tokens;
+};
+
+// the lines written for a TokenBatch
+struct CheckResult {
+    std::size_t chunk = 0;
+    std::size_t part = 0;
+    std::size_t partCount = 0;
+    std::string lines;
+};
+
+// a code point of the text and the number of bytes it takes
+struct CodePoint {
+    char32_t value = 0;
+    std::size_t size = 1;
+};
+
+// number of bytes of the UTF-8 sequence started by a byte, 1 for ASCII and
+// for bytes that can not start a sequence
+std::size_t sequenceLength(unsigned char byte) {
+    if (byte < 0xC2 || byte > 0xF4) {
+        return 1;
+    }
+
+    return byte < 0xE0 ? 2 : byte < 0xF0 ? 3 : 4;
+}
+
+// decodes the UTF-8 sequence at text[i]. A byte that does not start a
+// complete sequence is read as Latin-1, so text in other encodings is still
+// cut somewhere
+CodePoint decode(std::string_view text, std::size_t i) {
+    const auto byte = static_cast<unsigned char>(text[i]);
+    const std::size_t size = sequenceLength(byte);
+
+    if (size == 1 || i + size > text.size()) {
+        return {byte, 1};
+    }
+
+    char32_t value = byte & (0x7Fu >> size);
+
+    for (std::size_t j = 1; j < size; j++) {
+        const auto next = static_cast<unsigned char>(text[i + j]);
+
+        if ((next & 0xC0u) != 0x80u) {
+            return {byte, 1};
+        }
+
+        value = (value << 6) | (next & 0x3Fu);
+    }
+
+    return {value, size};
+}
+
+// the typographic quotes and dashes are read as an apostrophe or a hyphen,
+// '\0' for every other code point
+char joinerOf(char32_t c) {
+    if (c == '\'' || c == 0x2018 || c == 0x2019) {
+        return '\'';
+    }
+
+    return c == '-' || (c >= 0x2010 && c <= 0x2015) ? '-' : '\0';
+}
+
+// the punctuation and spaces of Latin-1 and of the general punctuation
+// block are not letters, every other code point above ASCII is
+bool isLetter(char32_t c) {
+    if (c < 0x80) {
+        const char32_t folded = c | 0x20u;
+        return folded >= 'a' && folded <= 'z';
+    }
+
+    return !(c >= 0xA0 && c <= 0xBF) && !(c >= 0x2000 && c <= 0x206F);
+}
+
+// a chunk is only cut at code points that can not be part of a token
+bool isSeparator(char32_t c) { return !isLetter(c) && joinerOf(c) == '\0'; }
+
+// length of the text up to the end of its last separator, or up to its last
+// complete code point if it has no separator
+std::size_t chunkCut(std::string_view text) {
+    std::size_t cut = 0;
+    std::size_t i = 0;
+
+    while (i < text.size()) {
+        // a sequence cut short by the end of the chunk ends in the next one
+        if (i + sequenceLength(static_cast<unsigned char>(text[i])) >
+            text.size()) {
+            break;
+        }
+
+        const CodePoint c = decode(text, i);
+        i += c.size;
+
+        if (isSeparator(c.value)) {
+            cut = i;
+        }
+    }
+
+    return cut != 0 ? cut : i;
+}
+
+// only ASCII is folded, like the words of the word file, and the quotes and
+// dashes standing for an apostrophe or a hyphen are replaced by them
+void lowercase(std::string_view token, std::string& folded) {
+    folded.clear();
+
+    for (std::size_t i = 0; i < token.size();) {
+        const CodePoint c = decode(token, i);
+        const char joiner = joinerOf(c.value);
+
+        if (joiner != '\0') {
+            folded += joiner;
+        } else if (c.value >= 'A' && c.value <= 'Z') {
+            folded += static_cast<char>(c.value | 0x20u);
+        } else {
+            folded.append(token.substr(i, c.size));
+        }
+
+        i += c.size;
+    }
+}
+
+// the stages run until the queue before them is closed, and the last thread
+// of a stage to finish closes the queue after it
+template <typename T>
+void finishStage(std::atomic<std::size_t>& running, BoundedQueue<T>& next) {
+    if (running.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        next.close();
+    }
+}
+
+}  // namespace
+
+int checkFile(
+    const std::string& path,
+    const std::function<bool(std::string_view)>& isWord,
+    const std::function<std::vector<Suggestion>(const std::string&)>& correct,
+    std::ostream& output, const CheckFileOptions& options) {
+    std::ifstream file;
+
+    if (path != "-") {
+        file.open(path, std::ios::binary);
+
+        if (!file.is_open()) {
+            std::cerr << "File at " << path << " could not be opened" << "\n";
+            return -1;
+        }
+    }
+
+    std::istream& input = path == "-" ? std::cin : file;
+
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const std::size_t threads =
+        options.threads != 0 ? options.threads : ThreadPool::shared().size();
+    const std::size_t chunkSize = std::max<std::size_t>(options.chunkSize, 1);
+    const std::size_t batchSize = std::max<std::size_t>(options.batchSize, 1);
+
+    // chunks read but not written yet, which bounds the memory of every stage
+    const std::size_t chunksAhead = 2 * threads + 2;
+
+    BoundedQueue<Chunk> chunks(chunksAhead);
+    BoundedQueue<TokenBatch> batches(4 * threads);
+    BoundedQueue<CheckResult> results(4 * threads);
+
+    std::atomic<std::size_t> writtenChunks = 0;
+    std::atomic<std::size_t> tokenCount = 0;
+    std::atomic<std::size_t> unknownCount = 0;
+    bool readFailed = false;
+
+    std::thread reader([&]() {
+        std::string carry;
+        std::uint64_t offset = 0;
+
+        for (std::size_t sequence = 0;; sequence++) {
+            while (sequence >= writtenChunks.load(std::memory_order_acquire) +
+                                   chunksAhead) {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+
+            std::string text = std::exchange(carry, std::string());
+            const std::size_t carried = text.size();
+
+            text.resize(carried + chunkSize);
+            input.read(text.data() + static_cast<std::ptrdiff_t>(carried),
+                       static_cast<std::streamsize>(chunkSize));
+            text.resize(carried + static_cast<std::size_t>(input.gcount()));
+
+            const bool end = !input;
+
+            // a token running to the end of the chunk may go on in the next
+            // one. A chunk without any separator is cut anyway, but never
+            // inside of a code point
+            if (!end) {
+                const std::size_t cut = chunkCut(text);
+
+                carry.assign(text, cut);
+                text.resize(cut);
+            }
+
+            const std::size_t size = text.size();
+            chunks.push({sequence, offset, std::move(text)});
+            offset += size;
+
+            if (end) {
+                readFailed = input.bad();
+                break;
+            }
+        }
+
+        chunks.close();
+    });
+
+    std::atomic<std::size_t> runningTokenizers = threads;
+    std::vector<std::thread> tokenizers;
+
+    for (std::size_t t = 0; t < threads; t++) {
+        tokenizers.emplace_back([&]() {
+            Chunk chunk;
+            std::vector<std::pair<std::uint64_t, std::string>> unknown;
+            std::string folded;
+
+            while (chunks.pop(chunk)) {
+                const std::string_view text = chunk.text;
+                std::size_t tokens = 0;
+
+                unknown.clear();
+
+                for (std::size_t i = 0; i < text.size();) {
+                    const CodePoint first = decode(text, i);
+
+                    if (!isLetter(first.value)) {
+                        i += first.size;
+                        continue;
+                    }
+
+                    const std::size_t tokenStart = i;
+                    i += first.size;
+
+                    // an apostrophe or a hyphen stays in the token only when
+                    // a letter follows it
+                    while (i < text.size()) {
+                        const CodePoint next = decode(text, i);
+                        const bool joined =
+                            joinerOf(next.value) != '\0' &&
+                            i + next.size < text.size() &&
+                            isLetter(decode(text, i + next.size).value);
+
+                        if (!isLetter(next.value) && !joined) {
+                            break;
+                        }
+
+                        i += next.size;
+                    }
+
+                    const std::string_view token =
+                        text.substr(tokenStart, i - tokenStart);
+
+                    tokens++;
+                    lowercase(token, folded);
+
+                    if (!isWord(folded)) {
+                        unknown.emplace_back(chunk.offset + tokenStart,
+                                             std::string(token));
+                    }
+                }
+
+                tokenCount.fetch_add(tokens, std::memory_order_relaxed);
+                unknownCount.fetch_add(unknown.size(),
+                                       std::memory_order_relaxed);
+
+                const std::size_t partCount =
+                    std::max<std::size_t>((unknown.size() + batchSize - 1) /
+                                              batchSize,
+                                          1);
+
+                for (std::size_t part = 0; part < partCount; part++) {
+                    TokenBatch batch{chunk.sequence, part, partCount, {}};
+                    const auto first =
+                        unknown.begin() +
+                        static_cast<std::ptrdiff_t>(part * batchSize);
+                    const auto last =
+                        part + 1 == partCount
+                            ? unknown.end()
+                            : first + static_cast<std::ptrdiff_t>(batchSize);
+
+                    batch.tokens.assign(std::make_move_iterator(first),
+                                        std::make_move_iterator(last));
+                    batches.push(std::move(batch));
+                }
+            }
+
+            finishStage(runningTokenizers, batches);
+        });
+    }
+
+    std::atomic<std::size_t> runningWorkers = threads;
+    std::vector<std::thread> workers;
+
+    for (std::size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&]() {
+            TokenBatch batch;
+            std::string folded;
+
+            while (batches.pop(batch)) {
+                CheckResult result{batch.chunk, batch.part, batch.partCount,
+                                   {}};
+
+                for (const auto& [offset, token] : batch.tokens) {
+                    result.lines += std::to_string(offset);
+                    result.lines += '\t';
+                    result.lines += token;
+                    result.lines += '\t';
+
+                    // same as in batch mode, too long to be a word
+                    if (token.size() <= maxWordLength) {
+                        bool first = true;
+
+                        lowercase(token, folded);
+
+                        for (const auto& suggestion : correct(folded)) {
+                            if (!first) {
+                                result.lines += ',';
+                            }
+
+                            result.lines += suggestion.word;
+                            first = false;
+                        }
+                    }
+
+                    result.lines += '\n';
+                }
+
+                results.push(std::move(result));
+            }
+
+            finishStage(runningWorkers, results);
+        });
+    }
+
+    // results arrive in any order, they are held back until every part of
+    // the chunks before them is written
+    std::map<std::pair<std::size_t, std::size_t>, CheckResult> waiting;
+    std::size_t nextChunk = 0;
+    std::size_t nextPart = 0;
+    CheckResult result;
+
+    while (results.pop(result)) {
+        const std::pair<std::size_t, std::size_t> key = {result.chunk,
+                                                         result.part};
+        waiting.emplace(key, std::move(result));
+
+        for (auto next = waiting.begin();
+             next != waiting.end() &&
+             next->first == std::pair{nextChunk, nextPart};
+             next = waiting.erase(next)) {
+            const std::string& lines = next->second.lines;
+            output.write(lines.data(),
+                         static_cast<std::streamsize>(lines.size()));
+
+            if (++nextPart == next->second.partCount) {
+                nextChunk++;
+                nextPart = 0;
+                writtenChunks.store(nextChunk, std::memory_order_release);
+            }
+        }
+    }
+
+    output.flush();
+
+    reader.join();
+
+    for (auto& tokenizer : tokenizers) {
+        tokenizer.join();
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (readFailed) {
+        std::cerr << "File at " << path << " could not be read" << "\n";
+        return -1;
+    }
+
+    const auto stop = std::chrono::high_resolution_clock::now();
+    const auto msduration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+
+    std::cerr << "Checked " << tokenCount.load() << " tokens ("
+              << unknownCount.load() << " unknown) in " << msduration.count()
+              << " ms" << "\n";
+
+    return 0;
+}
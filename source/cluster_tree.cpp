@@ -0,0 +1,277 @@
+#include "../include/cluster_tree.h"
+
+#include "../include/stats.h"
+#include "../include/word_signature.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <numeric>
+#include <unordered_map>
+#include <utility>
+
+ClusterTree::ClusterTree(const Dictionary& wordList,
+                         const ClusterTreeOptions& options)
+    : words(wordList), branches(std::max<std::size_t>(options.branches, 1)) {
+    if (words.empty()) {
+        return;
+    }
+
+    const std::size_t leafSize = std::max<std::size_t>(options.leafSize, 1);
+    const DictionaryDistance distance{&words};
+
+    // words of every node that is not laid out yet, node i is pending[i]
+    struct Pending {
+        std::vector<std::uint32_t> points;
+        std::size_t level;
+    };
+
+    std::vector<std::uint32_t> allWords(words.size());
+    std::iota(allWords.begin(), allWords.end(), std::uint32_t{0});
+
+    std::vector<Pending> pending;
+    pending.push_back({std::move(allWords), 0});
+    nodes.push_back({Dictionary::npos, 0, 0, 0, 0});
+
+    for (std::size_t position = 0; position < pending.size(); position++) {
+        // taken out, the list grows while the node is split
+        const std::vector<std::uint32_t> points =
+            std::move(pending[position].points);
+        const std::size_t level = pending[position].level;
+
+        std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> clusters;
+
+        // the top level is split with the clustering that was asked for
+        if (points.size() > leafSize && position == 0) {
+            clusters = options.sampled
+                           ? partitionAroundSampledMedoids(points, distance,
+                                                           options.sampling)
+                           : partitionAroundMedoidsCached(points, distance);
+        } else if (points.size() > leafSize) {
+            // the anomalous pattern search would split a cluster into many
+            // tiny ones, which waste most lanes of the batch kernels. Aiming
+            // for half a leaf leaves room for uneven clusters
+            const std::size_t fanout =
+                (2 * points.size() + leafSize - 1) / leafSize;
+            clusters = partitionIntoMedoids(points, fanout, distance,
+                                            options.sampling.swapPasses);
+        }
+
+        // a cluster that does not split any further stays a leaf, even if it
+        // is too large
+        if (clusters.size() < 2) {
+            nodes[position].firstMember =
+                static_cast<std::uint32_t>(members.size());
+            nodes[position].memberCount =
+                static_cast<std::uint32_t>(points.size());
+            members.insert(members.end(), points.begin(), points.end());
+
+            leaves++;
+            levels = std::max(levels, level);
+            largestLeafSize = std::max(largestLeafSize, points.size());
+            continue;
+        }
+
+        // the map has no order of its own, the children are sorted by medoid
+        // so the tree is the same on every run
+        std::vector<std::uint32_t> medoids;
+        medoids.reserve(clusters.size());
+
+        for (const auto& [medoid, cluster] : clusters) {
+            medoids.push_back(medoid);
+        }
+
+        std::ranges::sort(medoids);
+
+        nodes[position].firstChild = static_cast<std::uint32_t>(nodes.size());
+        nodes[position].childCount = static_cast<std::uint32_t>(medoids.size());
+
+        for (const auto medoid : medoids) {
+            nodes.push_back({medoid, 0, 0, 0, 0});
+            pending.push_back({std::move(clusters[medoid]), level + 1});
+        }
+    }
+
+    std::vector<std::uint32_t> ids;
+    std::vector<std::string_view> groupWords;
+
+    for (const auto& node : nodes) {
+        ids.clear();
+        groupWords.clear();
+
+        for (std::uint32_t i = 0; i < node.childCount; i++) {
+            ids.push_back(i);
+            groupWords.push_back(words[nodes[node.firstChild + i].medoid]);
+        }
+
+        for (std::uint32_t i = node.firstMember;
+             i < node.firstMember + node.memberCount; i++) {
+            ids.push_back(members[i]);
+            groupWords.push_back(words[members[i]]);
+        }
+
+        batches.addGroup(ids, groupWords);
+    }
+}
+
+std::vector<Suggestion> ClusterTree::nearest(const std::string& query,
+                                             std::size_t k,
+                                             int maxDist) const {
+    std::vector<Suggestion> suggestions;
+
+    if (nodes.empty() || k == 0 || maxDist < 0) {
+        return suggestions;
+    }
+
+    const bool batched = query.size() <= levBatchMaxLength;
+    const LevPattern pattern(query);
+    std::size_t examined = 0;
+
+    // descends one level at a time, following the closest children of the
+    // nodes followed so far. Ties go to the lower node. Nodes are kept with
+    // the distance of their medoid to the query
+    std::vector<std::pair<int, std::uint32_t>> followed = {{0, 0}};
+    std::vector<std::pair<int, std::uint32_t>> reached;
+    std::vector<std::pair<int, std::uint32_t>> children;
+    std::vector<int> childDistances;
+
+    while (!followed.empty()) {
+        children.clear();
+
+        for (const auto& [medoidDistance, index] : followed) {
+            const Node& node = nodes[index];
+
+            if (node.childCount == 0) {
+                reached.emplace_back(medoidDistance, index);
+                continue;
+            }
+
+            childDistances.resize(node.childCount);
+
+            if (batched) {
+                batches.distances(query, index, childDistances);
+            } else {
+                for (std::uint32_t i = 0; i < node.childCount; i++) {
+                    childDistances[i] = pattern.distance(
+                        words[nodes[node.firstChild + i].medoid]);
+                }
+            }
+
+            for (std::uint32_t i = 0; i < node.childCount; i++) {
+                children.emplace_back(childDistances[i], node.firstChild + i);
+            }
+        }
+
+        examined += children.size();
+
+        const auto followedEnd =
+            children.begin() +
+            static_cast<std::ptrdiff_t>(std::min(branches, children.size()));
+        std::partial_sort(children.begin(), followedEnd, children.end());
+
+        followed.assign(children.begin(), followedEnd);
+    }
+
+    // the closest leaves first, so the bound is tight early on
+    std::ranges::sort(reached);
+
+    // max-heap on (distance, word), the front is the worst of the k best so
+    // far and bounds the filters and the distance calculations
+    std::vector<std::pair<int, std::uint32_t>> best;
+    const WordSignature querySignature = wordSignature(query);
+    const auto signatures = words.signatures();
+
+    const auto bound = [&best, k, maxDist]() {
+        return best.size() < k ? maxDist
+                               : std::min(maxDist, best.front().first);
+    };
+
+    const auto offer = [&best, k, &bound](int distance, std::uint32_t word) {
+        const std::pair<int, std::uint32_t> candidate = {distance, word};
+
+        if (distance > bound()) {
+            return;
+        }
+
+        if (best.size() < k) {
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end());
+        } else if (candidate < best.front()) {
+            std::pop_heap(best.begin(), best.end());
+            best.back() = candidate;
+            std::push_heap(best.begin(), best.end());
+        }
+    };
+
+    std::array<int, levBatchLanes> distances;
+
+    for (const auto& [medoidDistance, leaf] : reached) {
+        const Node& node = nodes[leaf];
+
+        if (batched) {
+            // whole blocks are ruled out at once, as in the cluster scans
+            const LevBatchWords::GroupView& blocks = batches.group(leaf);
+
+            for (const auto& block : blocks) {
+                examined += block.itemCount;
+                statsAdd(StatCounter::FilterChecks, block.itemCount);
+
+                const std::size_t lengthDifference =
+                    block.length > query.size() ? block.length - query.size()
+                                                : query.size() - block.length;
+
+                if (lengthDifference > static_cast<std::size_t>(bound())) {
+                    statsAdd(StatCounter::FilterLengthRejects,
+                             block.itemCount);
+                    statsAdd(StatCounter::FilterSkippedLev, block.itemCount);
+                    continue;
+                }
+
+                if (blockClassBound(querySignature, block) > bound()) {
+                    statsAdd(StatCounter::FilterClassRejects, block.itemCount);
+                    statsAdd(StatCounter::FilterSkippedLev, block.itemCount);
+                    continue;
+                }
+
+                LevBatchWords::distances(query, blocks, block, distances);
+
+                const auto ids = blocks.items(block);
+
+                for (std::size_t lane = 0; lane < ids.size(); lane++) {
+                    offer(distances[lane], ids[lane]);
+                }
+            }
+
+            continue;
+        }
+
+        for (std::uint32_t i = node.firstMember;
+             i < node.firstMember + node.memberCount; i++) {
+            const std::uint32_t member = members[i];
+            const int memberBound = bound();
+
+            examined++;
+
+            if (signaturesExceed(querySignature, signatures[member],
+                                 memberBound)) {
+                statsAdd(StatCounter::FilterSkippedLev);
+                continue;
+            }
+
+            offer(levBounded(query, words[member], memberBound), member);
+        }
+    }
+
+    statsAdd(StatCounter::Queries);
+    statsAdd(StatCounter::CandidatesExamined, examined);
+    statsRecord(StatHistogram::CandidatesPerQuery, examined);
+
+    std::sort_heap(best.begin(), best.end());
+    suggestions.reserve(best.size());
+
+    for (const auto& [distance, member] : best) {
+        suggestions.push_back({std::string(words[member]), distance, member});
+    }
+
+    return suggestions;
+}
@@ -0,0 +1,693 @@
+#include "../include/dictionary.h"
+
+#include "../include/clustering.h"
+#include "../include/distance_cache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SPELLCHECKER_X86_64 1
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+constexpr std::size_t groupSize = 12;
+constexpr std::uint8_t emptyTag = 0x80;
+constexpr std::uint8_t paddingTag = 0xFF;
+
+// the low bits of the hash pick the group, the top 7 bits are the tag
+std::uint8_t tagOf(std::uint64_t wordHash) {
+    return static_cast<std::uint8_t>(wordHash >> 57);
+}
+
+// bit i is set where tags[i] equals the tag, the tags are 16-byte aligned
+std::uint32_t matchTags(const std::uint8_t* tags, std::uint8_t tag) {
+#ifdef SPELLCHECKER_X86_64
+    const __m128i group =
+        _mm_load_si128(reinterpret_cast<const __m128i*>(tags));
+
+    return static_cast<std::uint32_t>(_mm_movemask_epi8(
+        _mm_cmpeq_epi8(group, _mm_set1_epi8(static_cast<char>(tag)))));
+#else
+    std::uint32_t matches = 0;
+
+    for (std::size_t i = 0; i < 16; i++) {
+        matches |= std::uint32_t{tags[i] == tag} << i;
+    }
+
+    return matches;
+#endif
+}
+
+}  // namespace
+
+std::uint64_t Dictionary::hash(std::string_view word) {
+    // FNV-1a
+    std::uint64_t wordHash = 0xCBF29CE484222325ull;
+
+    for (const char c : word) {
+        wordHash ^= static_cast<unsigned char>(c);
+        wordHash *= 0x100000001B3ull;
+    }
+
+    return wordHash;
+}
+
+Dictionary::Slot Dictionary::slotIn(std::span<const SlotGroup> table,
+                                    std::span<const std::uint32_t> wordOffsets,
+                                    std::string_view blob,
+                                    std::string_view word,
+                                    std::uint64_t wordHash) {
+    const std::size_t groupMask = table.size() - 1;
+    const std::uint8_t tag = tagOf(wordHash);
+    std::size_t group = static_cast<std::size_t>(wordHash) & groupMask;
+
+    // words are never removed, so the first group with an empty slot ends
+    // the probe sequence
+    while (true) {
+        const SlotGroup& slots = table[group];
+
+        for (std::uint32_t matches = matchTags(slots.tags.data(), tag);
+             matches != 0; matches &= matches - 1) {
+            const auto index = static_cast<std::size_t>(
+                std::countr_zero(matches));
+            const std::uint32_t candidate = slots.words[index];
+
+            if (blob.substr(wordOffsets[candidate],
+                            wordOffsets[candidate + 1] -
+                                wordOffsets[candidate]) == word) {
+                return {group, index};
+            }
+        }
+
+        const std::uint32_t empty = matchTags(slots.tags.data(), emptyTag);
+
+        if (empty != 0) {
+            return {group, static_cast<std::size_t>(std::countr_zero(empty))};
+        }
+
+        group = (group + 1) & groupMask;
+    }
+}
+
+void Dictionary::growTable(std::size_t wordCount) {
+    // at most 7/8 full, a probe rarely has to look past the first group
+    std::size_t groups = 2;
+
+    while (groups * groupSize * 7 < wordCount * 8) {
+        groups *= 2;
+    }
+
+    if (groups <= table.size()) {
+        return;
+    }
+
+    SlotGroup emptyGroup;
+    emptyGroup.tags.fill(paddingTag);
+    std::fill_n(emptyGroup.tags.begin(), groupSize, emptyTag);
+    emptyGroup.words.fill(0);
+
+    table.assign(groups, emptyGroup);
+
+    for (std::uint32_t i = 0; i < size(); i++) {
+        const std::uint64_t wordHash = hash((*this)[i]);
+        const Slot slot = slotOf((*this)[i], wordHash);
+
+        table[slot.group].tags[slot.index] = tagOf(wordHash);
+        table[slot.group].words[slot.index] = i;
+    }
+}
+
+std::pair<std::uint32_t, bool> Dictionary::insert(std::string_view word) {
+    return insert(word, hash(word), wordSignature(word));
+}
+
+std::pair<std::uint32_t, bool> Dictionary::insert(
+    std::string_view word, std::uint64_t wordHash,
+    const WordSignature& signature) {
+    growTable(size() + 1);
+
+    const Slot slot = slotOf(word, wordHash);
+    SlotGroup& slots = table[slot.group];
+
+    if (slots.tags[slot.index] != emptyTag) {
+        return {slots.words[slot.index], false};
+    }
+
+    const auto index = static_cast<std::uint32_t>(size());
+
+    blob += word;
+    offsets.push_back(static_cast<std::uint32_t>(blob.size()));
+    wordSignatures.push_back(signature);
+    slots.tags[slot.index] = tagOf(wordHash);
+    slots.words[slot.index] = index;
+
+    return {index, true};
+}
+
+std::uint32_t Dictionary::find(std::string_view word) const {
+    return find(word, table, offsets, blob);
+}
+
+std::uint32_t Dictionary::find(std::string_view word,
+                               std::span<const SlotGroup> table,
+                               std::span<const std::uint32_t> wordOffsets,
+                               std::string_view blob) {
+    if (table.empty()) {
+        return npos;
+    }
+
+    const Slot slot = slotIn(table, wordOffsets, blob, word, hash(word));
+    const SlotGroup& slots = table[slot.group];
+
+    return slots.tags[slot.index] == emptyTag ? npos
+                                              : slots.words[slot.index];
+}
+
+bool Dictionary::isValidLookupTable(std::span<const SlotGroup> table,
+                                    std::size_t wordCount) {
+    // an empty table is never probed
+    if (table.empty()) {
+        return wordCount == 0;
+    }
+
+    if (!std::has_single_bit(table.size())) {
+        return false;
+    }
+
+    bool hasEmptySlot = false;
+
+    for (const auto& slots : table) {
+        for (std::size_t i = 0; i < slots.tags.size(); i++) {
+            const std::uint8_t tag = slots.tags[i];
+
+            if (i >= groupSize) {
+                if (tag != paddingTag) {
+                    return false;
+                }
+            } else if (tag == emptyTag) {
+                hasEmptySlot = true;
+            } else if (tag > emptyTag || slots.words[i] >= wordCount) {
+                return false;
+            }
+        }
+    }
+
+    return hasEmptySlot;
+}
+
+void Dictionary::reserve(std::size_t wordCount, std::size_t byteCount) {
+    blob.reserve(byteCount);
+    offsets.reserve(wordCount + 1);
+    wordSignatures.reserve(wordCount);
+    growTable(wordCount);
+}
+
+std::size_t Dictionary::memoryUsage() const {
+    return sizeof(*this) + blob.capacity() +
+           offsets.capacity() * sizeof(std::uint32_t) +
+           wordSignatures.capacity() * sizeof(WordSignature) +
+           table.capacity() * sizeof(SlotGroup);
+}
+
+ClusterIndex::ClusterIndex(
+    Dictionary clusteredWords,
+    const std::unordered_map<std::uint32_t, std::vector<std::uint32_t>>&
+        clusters)
+    : words(std::move(clusteredWords)) {
+    medoids.reserve(clusters.size());
+
+    for (const auto& medoidClusterPair : clusters) {
+        medoids.push_back(medoidClusterPair.first);
+    }
+
+    // the cluster map has no order of its own, keep the index reproducible
+    std::sort(medoids.begin(), medoids.end());
+
+    clusterStarts.reserve(medoids.size() + 1);
+    clusterStarts.push_back(0);
+    members.reserve(words.size());
+    clusterOf.assign(words.size(), Dictionary::npos);
+    medoidDistances.assign(words.size(), 0);
+    radii.assign(medoids.size(), 0);
+    drift.reserve(medoids.size());
+
+    for (std::uint32_t cluster = 0; cluster < medoids.size(); cluster++) {
+        const auto first = members.end() - members.begin();
+        const std::uint32_t medoid = medoids[cluster];
+        std::uint64_t cost = 0;
+
+        for (const auto member : clusters.at(medoid)) {
+            clusterOf[member] = cluster;
+            medoidDistances[member] =
+                static_cast<std::uint32_t>(lev(words[member], words[medoid]));
+            cost += medoidDistances[member];
+            radii[cluster] = std::max(radii[cluster], medoidDistances[member]);
+            members.push_back(member);
+        }
+
+        std::sort(members.begin() + first, members.end(),
+                  [this](std::uint32_t a, std::uint32_t b) {
+                      return comesBefore(a, b);
+                  });
+
+        clusterStarts.push_back(static_cast<std::uint32_t>(members.size()));
+        drift.push_back({clusterStarts[cluster + 1] - clusterStarts[cluster],
+                         cost, cost, 0});
+    }
+
+    updateView();
+
+    batches = std::make_unique<LevBatchWords>(batchClusterIndex(indexView));
+    indexView.batches = batches.get();
+}
+
+ClusterIndex::ClusterIndex(ClusterIndex&& other) noexcept
+    : words(std::move(other.words)),
+      medoids(std::move(other.medoids)),
+      clusterStarts(std::move(other.clusterStarts)),
+      members(std::move(other.members)),
+      batches(std::move(other.batches)),
+      clusterOf(std::move(other.clusterOf)),
+      medoidDistances(std::move(other.medoidDistances)),
+      radii(std::move(other.radii)),
+      drift(std::move(other.drift)),
+      driftLimits(other.driftLimits) {
+    updateView();
+    other.indexView = {};
+}
+
+ClusterIndex& ClusterIndex::operator=(ClusterIndex&& other) noexcept {
+    words = std::move(other.words);
+    medoids = std::move(other.medoids);
+    clusterStarts = std::move(other.clusterStarts);
+    members = std::move(other.members);
+    batches = std::move(other.batches);
+    clusterOf = std::move(other.clusterOf);
+    medoidDistances = std::move(other.medoidDistances);
+    radii = std::move(other.radii);
+    drift = std::move(other.drift);
+    driftLimits = other.driftLimits;
+
+    updateView();
+    other.indexView = {};
+
+    return *this;
+}
+
+void ClusterIndex::updateView() {
+    indexView.blob = words.bytes();
+    indexView.wordOffsets = words.wordOffsets();
+    indexView.medoids = medoids;
+    indexView.clusterStarts = clusterStarts;
+    indexView.members = members;
+    indexView.signatures = words.signatures();
+    indexView.medoidDistances = medoidDistances;
+    indexView.radii = radii;
+    indexView.batches = batches.get();
+}
+
+ClusterUpdate ClusterIndex::addWord(std::string_view word) {
+    const auto [index, inserted] = words.insert(word);
+
+    if (!inserted && clusterOf[index] != Dictionary::npos) {
+        return {false, clusterOf[index], false, false};
+    }
+
+    clusterOf.resize(words.size(), Dictionary::npos);
+    medoidDistances.resize(words.size(), 0);
+
+    if (clusterStarts.empty()) {
+        clusterStarts.push_back(0);
+    }
+
+    if (!batches) {
+        batches = std::make_unique<LevBatchWords>();
+        batches->addGroup({}, {});
+    }
+
+    ClusterUpdate update = {true, 0, false, false};
+
+    if (medoids.empty()) {
+        // the first word starts a cluster of its own
+        medoids.push_back(index);
+        medoidDistances[index] = 0;
+        clusterStarts.push_back(clusterStarts.back());
+        radii.push_back(0);
+        drift.push_back({0, 0, 0, 0});
+        batches->addGroup({}, {});
+        layOutMedoids();
+    } else {
+        std::vector<int> distances(medoids.size());
+        batches->distances(words[index], 0, distances);
+
+        const auto closest =
+            std::min_element(distances.begin(), distances.end());
+
+        update.cluster =
+            static_cast<std::uint32_t>(closest - distances.begin());
+        medoidDistances[index] = static_cast<std::uint32_t>(*closest);
+    }
+
+    const std::uint32_t cluster = update.cluster;
+
+    // keep the members sorted, see comesBefore
+    members.insert(
+        std::lower_bound(members.begin() + clusterStarts[cluster],
+                         members.begin() + clusterStarts[cluster + 1], index,
+                         [this](std::uint32_t a, std::uint32_t b) {
+                             return comesBefore(a, b);
+                         }),
+        index);
+
+    for (std::size_t i = cluster + 1; i < clusterStarts.size(); i++) {
+        clusterStarts[i]++;
+    }
+
+    clusterOf[index] = cluster;
+    drift[cluster].cost += medoidDistances[index];
+    drift[cluster].changes++;
+    layOutCluster(cluster);
+    measureRadius(cluster);
+
+    if (hasDrifted(cluster)) {
+        chooseMedoid(cluster);
+        update.medoidChosen = true;
+        update.cluster = clusterOf[index];
+    }
+
+    updateView();
+
+    return update;
+}
+
+ClusterUpdate ClusterIndex::removeWord(std::string_view word) {
+    const std::uint32_t index = words.find(word);
+
+    if (index == Dictionary::npos || clusterOf[index] == Dictionary::npos) {
+        return {false, 0, false, false};
+    }
+
+    const std::uint32_t cluster = clusterOf[index];
+    ClusterUpdate update = {true, cluster, false, false};
+
+    members.erase(std::find(members.begin() + clusterStarts[cluster],
+                            members.begin() + clusterStarts[cluster + 1],
+                            index));
+
+    for (std::size_t i = cluster + 1; i < clusterStarts.size(); i++) {
+        clusterStarts[i]--;
+    }
+
+    clusterOf[index] = Dictionary::npos;
+    drift[cluster].cost -= medoidDistances[index];
+    drift[cluster].changes++;
+
+    if (clusterStarts[cluster] == clusterStarts[cluster + 1]) {
+        removeCluster(cluster);
+        update.clusterRemoved = true;
+    } else {
+        layOutCluster(cluster);
+        measureRadius(cluster);
+
+        // a medoid has to be a member of its cluster, otherwise the distance
+        // to it is no longer the distance to a candidate
+        if (medoids[cluster] == index || hasDrifted(cluster)) {
+            chooseMedoid(cluster);
+            update.medoidChosen = true;
+        }
+    }
+
+    updateView();
+
+    return update;
+}
+
+bool ClusterIndex::comesBefore(std::uint32_t a, std::uint32_t b) const {
+    const std::size_t aSize = words[a].size();
+    const std::size_t bSize = words[b].size();
+
+    if (aSize != bSize) {
+        return aSize < bSize;
+    }
+
+    return medoidDistances[a] < medoidDistances[b] ||
+           (medoidDistances[a] == medoidDistances[b] && a < b);
+}
+
+bool ClusterIndex::hasDrifted(std::uint32_t cluster) const {
+    const ClusterDrift& state = drift[cluster];
+    const auto size = static_cast<double>(clusterStarts[cluster + 1] -
+                                          clusterStarts[cluster]);
+
+    if (state.changes >=
+        std::max(1.0, driftLimits.sizeChange * state.selectedSize)) {
+        return true;
+    }
+
+    // a cluster that had no other members yet has no mean to compare to, the
+    // size limit covers it
+    if (state.selectedSize <= 1) {
+        return false;
+    }
+
+    const double selectedMean =
+        static_cast<double>(state.selectedCost) / state.selectedSize;
+    const double mean = static_cast<double>(state.cost) / size;
+
+    return std::abs(mean - selectedMean) > driftLimits.costChange * selectedMean;
+}
+
+void ClusterIndex::chooseMedoid(std::uint32_t cluster) {
+    const std::vector<std::uint32_t> points(
+        members.begin() + clusterStarts[cluster],
+        members.begin() + clusterStarts[cluster + 1]);
+    const std::uint32_t medoid =
+        findCentralMedoid(points, DictionaryDistance{&words});
+
+    if (medoid != medoids[cluster]) {
+        medoids[cluster] = medoid;
+        layOutMedoids();
+        assignAround(cluster);
+    }
+
+    std::uint64_t cost = 0;
+
+    for (std::uint32_t i = clusterStarts[cluster];
+         i < clusterStarts[cluster + 1]; i++) {
+        cost += medoidDistances[members[i]];
+    }
+
+    drift[cluster] = {clusterStarts[cluster + 1] - clusterStarts[cluster],
+                      cost, cost, 0};
+}
+
+// The assignment step of partitionAroundMedoids, limited to what a new medoid
+// changes: words of other clusters that are closer to it than to their own
+// medoid join the cluster, and members of the cluster that are closer to
+// another medoid leave it. Both are found with the batch kernels, so this
+// costs one pass over the words rather than a new clustering
+void ClusterIndex::assignAround(std::uint32_t cluster) {
+    const std::uint32_t medoid = medoids[cluster];
+    std::vector<int> distances(words.size());
+    std::vector<int> toMedoids(medoids.size());
+    std::vector<std::vector<std::uint32_t>> arrivals(medoids.size());
+    std::vector<bool> touched(medoids.size(), false);
+
+    for (std::uint32_t other = 0; other < medoids.size(); other++) {
+        if (other == cluster) {
+            continue;
+        }
+
+        batches->distances(words[medoid], other + 1, distances);
+
+        for (std::uint32_t i = clusterStarts[other];
+             i < clusterStarts[other + 1]; i++) {
+            const std::uint32_t member = members[i];
+            const auto distance = static_cast<std::uint32_t>(distances[member]);
+
+            if (distance < medoidDistances[member]) {
+                drift[other].cost -= medoidDistances[member];
+                drift[other].changes++;
+                clusterOf[member] = cluster;
+                medoidDistances[member] = distance;
+                arrivals[cluster].push_back(member);
+                touched[other] = true;
+            }
+        }
+    }
+
+    for (std::uint32_t i = clusterStarts[cluster];
+         i < clusterStarts[cluster + 1]; i++) {
+        const std::uint32_t member = members[i];
+
+        batches->distances(words[member], 0, toMedoids);
+
+        // ties stay in the cluster
+        std::uint32_t closest = cluster;
+
+        for (std::uint32_t other = 0; other < medoids.size(); other++) {
+            if (toMedoids[other] < toMedoids[closest]) {
+                closest = other;
+            }
+        }
+
+        medoidDistances[member] = static_cast<std::uint32_t>(toMedoids[closest]);
+
+        if (closest != cluster) {
+            drift[closest].cost += medoidDistances[member];
+            drift[closest].changes++;
+            clusterOf[member] = closest;
+            arrivals[closest].push_back(member);
+            touched[closest] = true;
+        }
+    }
+
+    touched[cluster] = true;
+
+    std::vector<std::uint32_t> regrouped;
+    std::vector<std::uint32_t> starts = {0};
+
+    regrouped.reserve(members.size());
+    starts.reserve(clusterStarts.size());
+
+    for (std::uint32_t other = 0; other < medoids.size(); other++) {
+        const auto first = regrouped.end() - regrouped.begin();
+
+        for (std::uint32_t i = clusterStarts[other];
+             i < clusterStarts[other + 1]; i++) {
+            if (clusterOf[members[i]] == other) {
+                regrouped.push_back(members[i]);
+            }
+        }
+
+        // the members of the cluster itself are now at other distances
+        if (!arrivals[other].empty() || other == cluster) {
+            regrouped.insert(regrouped.end(), arrivals[other].begin(),
+                             arrivals[other].end());
+            std::sort(regrouped.begin() + first, regrouped.end(),
+                      [this](std::uint32_t a, std::uint32_t b) {
+                          return comesBefore(a, b);
+                      });
+        }
+
+        starts.push_back(static_cast<std::uint32_t>(regrouped.size()));
+    }
+
+    members = std::move(regrouped);
+    clusterStarts = std::move(starts);
+
+    for (std::uint32_t other = 0; other < medoids.size(); other++) {
+        if (touched[other]) {
+            layOutCluster(other);
+            measureRadius(other);
+        }
+    }
+}
+
+void ClusterIndex::removeCluster(std::uint32_t cluster) {
+    medoids.erase(medoids.begin() + cluster);
+    clusterStarts.erase(clusterStarts.begin() + cluster + 1);
+    radii.erase(radii.begin() + cluster);
+    drift.erase(drift.begin() + cluster);
+    batches->removeGroup(cluster + 1);
+
+    for (auto& wordCluster : clusterOf) {
+        if (wordCluster != Dictionary::npos && wordCluster > cluster) {
+            wordCluster--;
+        }
+    }
+
+    layOutMedoids();
+}
+
+void ClusterIndex::layOutCluster(std::uint32_t cluster) {
+    const auto clusterMembers = std::span<const std::uint32_t>(members).subspan(
+        clusterStarts[cluster],
+        clusterStarts[cluster + 1] - clusterStarts[cluster]);
+    std::vector<std::string_view> clusterWords;
+
+    clusterWords.reserve(clusterMembers.size());
+
+    for (const auto member : clusterMembers) {
+        clusterWords.push_back(words[member]);
+    }
+
+    batches->setGroup(cluster + 1, clusterMembers, clusterWords);
+}
+
+void ClusterIndex::measureRadius(std::uint32_t cluster) {
+    radii[cluster] = 0;
+
+    for (std::uint32_t i = clusterStarts[cluster];
+         i < clusterStarts[cluster + 1]; i++) {
+        radii[cluster] = std::max(radii[cluster], medoidDistances[members[i]]);
+    }
+}
+
+void ClusterIndex::layOutMedoids() {
+    std::vector<std::uint32_t> ids(medoids.size());
+    std::vector<std::string_view> medoidWords;
+
+    std::iota(ids.begin(), ids.end(), std::uint32_t{0});
+    medoidWords.reserve(medoids.size());
+
+    for (const auto medoid : medoids) {
+        medoidWords.push_back(words[medoid]);
+    }
+
+    batches->setGroup(0, ids, medoidWords);
+}
+
+std::size_t ClusterIndex::memoryUsage() const {
+    return sizeof(*this) - sizeof(words) + words.memoryUsage() +
+           (medoids.capacity() + clusterStarts.capacity() +
+            members.capacity() + clusterOf.capacity() +
+            medoidDistances.capacity() + radii.capacity()) *
+               sizeof(std::uint32_t) +
+           drift.capacity() * sizeof(ClusterDrift) +
+           (batches ? batches->memoryUsage() : 0);
+}
+
+int DictionaryDistance::operator()(std::uint32_t a, std::uint32_t b) const {
+    return lev((*words)[a], (*words)[b]);
+}
+
+int DictionaryDistance::operator()(std::uint32_t a, std::uint32_t b,
+                                   int maxDist) const {
+    const auto signatures = words->signatures();
+
+    if (signaturesExceed(signatures[a], signatures[b], maxDist)) {
+        statsAdd(StatCounter::FilterSkippedLev);
+        return maxDist + 1;
+    }
+
+    return levBounded((*words)[a], (*words)[b], maxDist);
+}
+
+ClusterIndex clusterDictionary(Dictionary words) {
+    std::vector<std::uint32_t> indices(words.size());
+    std::iota(indices.begin(), indices.end(), std::uint32_t{0});
+
+    // the points are the word indices themselves, so the clusters come out as
+    // index arrays and no word is ever copied
+    const auto clusters =
+        partitionAroundMedoidsCached(indices, DictionaryDistance{&words});
+
+    return ClusterIndex(std::move(words), clusters);
+}
+
+ClusterIndex clusterDictionary(Dictionary words,
+                               const SamplingOptions& options) {
+    std::vector<std::uint32_t> indices(words.size());
+    std::iota(indices.begin(), indices.end(), std::uint32_t{0});
+
+    const auto clusters = partitionAroundSampledMedoids(
+        indices, DictionaryDistance{&words}, options);
+
+    return ClusterIndex(std::move(words), clusters);
+}
@@ -0,0 +1,399 @@
+#include "../include/index_file.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <type_traits>
+
+namespace {
+
+constexpr char indexFileMagic[8] = {'S', 'P', 'C', 'K', 'I', 'D', 'X', '\0'};
+
+static_assert(sizeof(IndexFileHeader) == 56,
+              "the header is part of the file format");
+
+std::uint64_t fnv1a(std::string_view bytes) {
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (const char c : bytes) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+// Sections start at a multiple of sectionAlignment from the start of the
+// file. mmap hands out page-aligned memory, so every array can be used in
+// place, whatever its type
+constexpr std::size_t sectionAlignment = 64;
+
+static_assert(std::is_trivially_copyable_v<WordSignature> &&
+                  sizeof(WordSignature) == 32,
+              "signatures are part of the file format");
+static_assert(std::is_trivially_copyable_v<LevBatchWords::Block> &&
+                  sizeof(LevBatchWords::Block) == 24,
+              "blocks of the batch kernels are part of the file format");
+static_assert(std::is_trivially_copyable_v<Dictionary::SlotGroup> &&
+                  sizeof(Dictionary::SlotGroup) == 64,
+              "the lookup table is part of the file format");
+
+// Appends an array to the body of the file, which starts after the header
+template <typename T>
+void appendSection(std::string& body, std::span<const T> array) {
+    const std::size_t misalignment =
+        (sizeof(IndexFileHeader) + body.size()) % sectionAlignment;
+
+    if (misalignment != 0) {
+        body.append(sectionAlignment - misalignment, '\0');
+    }
+
+    body.append(reinterpret_cast<const char*>(array.data()),
+                array.size() * sizeof(T));
+}
+
+// Reads the sections of a file in the order appendSection wrote them
+class SectionReader {
+public:
+    explicit SectionReader(std::string_view fileContents)
+        : contents(fileContents), offset(sizeof(IndexFileHeader)) {}
+
+    // returns an empty span and marks the file as truncated if the section
+    // does not fit into the file
+    template <typename T>
+    std::span<const T> next(std::size_t count) {
+        offset = (offset + sectionAlignment - 1) / sectionAlignment *
+                 sectionAlignment;
+
+        if (offset > contents.size() ||
+            count > (contents.size() - offset) / sizeof(T)) {
+            truncated = true;
+            offset = contents.size();
+            return {};
+        }
+
+        const auto* first =
+            reinterpret_cast<const T*>(contents.data() + offset);
+        offset += count * sizeof(T);
+
+        return {first, count};
+    }
+
+    // whether every section was there and nothing follows the last one
+    bool isComplete() const {
+        return !truncated && offset == contents.size();
+    }
+
+private:
+    std::string_view contents;
+    std::size_t offset;
+    bool truncated = false;
+};
+
+bool isAscending(std::span<const std::uint32_t> values, std::uint32_t last) {
+    return !values.empty() && values.front() == 0 && values.back() == last &&
+           std::is_sorted(values.begin(), values.end());
+}
+
+// Checks that the batch layout of a file covers the clusters of its view and
+// reads nothing outside of its arrays
+bool isValidBatchLayout(const ClusterIndexView& view,
+                        std::span<const std::uint32_t> blockStarts,
+                        std::span<const LevBatchWords::Block> blocks,
+                        std::span<const std::uint32_t> ids,
+                        std::span<const char> chars) {
+    if (!isAscending(blockStarts, static_cast<std::uint32_t>(blocks.size()))) {
+        return false;
+    }
+
+    for (std::size_t group = 0; group + 1 < blockStarts.size(); group++) {
+        // group 0 holds the medoids, numbered by their cluster
+        const std::size_t itemCount =
+            group == 0 ? view.clusterCount() : view.cluster(group - 1).size();
+        const std::size_t idLimit =
+            group == 0 ? view.clusterCount() : view.wordCount();
+        std::size_t items = 0;
+
+        for (std::uint32_t b = blockStarts[group]; b < blockStarts[group + 1];
+             b++) {
+            const LevBatchWords::Block& block = blocks[b];
+
+            if (block.itemCount == 0 || block.itemCount > levBatchLanes ||
+                block.firstItem > ids.size() ||
+                block.itemCount > ids.size() - block.firstItem ||
+                block.firstChar > chars.size() ||
+                std::uint64_t{block.length} * levBatchLanes >
+                    chars.size() - block.firstChar) {
+                return false;
+            }
+
+            const auto blockIds = ids.subspan(block.firstItem, block.itemCount);
+
+            if (!std::all_of(blockIds.begin(), blockIds.end(),
+                             [idLimit](std::uint32_t id) {
+                                 return id < idLimit;
+                             })) {
+                return false;
+            }
+
+            items += block.itemCount;
+        }
+
+        if (items != itemCount) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+}  // namespace
+
+int writeIndexFile(const std::string& path, const ClusterIndexView& index) {
+    // every word has to be in exactly one cluster and offsets are 32-bit
+    if (index.members.size() != index.wordCount() ||
+        index.medoidDistances.size() != index.wordCount() ||
+        index.radii.size() != index.clusterCount() ||
+        index.blob.size() > std::numeric_limits<std::uint32_t>::max()) {
+        return -1;
+    }
+
+    // signatures are only left out of views that do without the filters
+    std::vector<WordSignature> calculatedSignatures;
+    std::span<const WordSignature> signatures = index.signatures;
+
+    if (signatures.size() != index.wordCount()) {
+        calculatedSignatures.reserve(index.wordCount());
+
+        for (std::uint32_t i = 0; i < index.wordCount(); i++) {
+            calculatedSignatures.push_back(wordSignature(index.word(i)));
+        }
+
+        signatures = calculatedSignatures;
+    }
+
+    // the batch layout is written flat, the blocks counting their items and
+    // characters from the start of all groups
+    std::optional<LevBatchWords> calculatedBatches;
+    const LevBatchWords* batches = index.batches;
+
+    if (batches == nullptr) {
+        calculatedBatches.emplace(batchClusterIndex(index));
+        batches = &*calculatedBatches;
+    }
+
+    if (batches->groupCount() != index.clusterCount() + 1) {
+        return -1;
+    }
+
+    std::vector<std::uint32_t> blockStarts = {0};
+    std::vector<LevBatchWords::Block> blocks;
+    std::vector<std::uint32_t> batchIds;
+    std::vector<char> batchChars;
+
+    for (std::size_t group = 0; group < batches->groupCount(); group++) {
+        const LevBatchWords::GroupView& groupBlocks = batches->group(group);
+
+        for (const auto& block : groupBlocks) {
+            const auto blockIds = groupBlocks.items(block);
+            const char* blockChars = groupBlocks.chars + block.firstChar;
+
+            LevBatchWords::Block flatBlock = block;
+            flatBlock.firstItem = static_cast<std::uint32_t>(batchIds.size());
+            flatBlock.firstChar = static_cast<std::uint32_t>(batchChars.size());
+            blocks.push_back(flatBlock);
+
+            batchIds.insert(batchIds.end(), blockIds.begin(), blockIds.end());
+            batchChars.insert(batchChars.end(), blockChars,
+                              blockChars + block.length * levBatchLanes);
+        }
+
+        blockStarts.push_back(static_cast<std::uint32_t>(blocks.size()));
+    }
+
+    // the blocks count the characters with 32 bits
+    if (batchChars.size() > std::numeric_limits<std::uint32_t>::max()) {
+        return -1;
+    }
+
+    // the words are unique, so they keep their indices in the dictionary
+    Dictionary words;
+    words.reserve(index.wordCount(), index.blob.size());
+
+    for (std::uint32_t i = 0; i < index.wordCount(); i++) {
+        words.insert(index.word(i));
+    }
+
+    if (words.size() != index.wordCount()) {
+        return -1;
+    }
+
+    std::string body;
+    appendSection(body, index.wordOffsets);
+    appendSection(body, index.medoids);
+    appendSection(body, index.clusterStarts);
+    appendSection(body, index.members);
+    appendSection(body, index.medoidDistances);
+    appendSection(body, index.radii);
+    appendSection(body, signatures);
+    appendSection(body, std::span<const std::uint32_t>(blockStarts));
+    appendSection(body, std::span<const LevBatchWords::Block>(blocks));
+    appendSection(body, std::span<const std::uint32_t>(batchIds));
+    appendSection(body, std::span<const char>(batchChars));
+    appendSection(body, words.lookupTable());
+    appendSection(body, std::span<const char>(index.blob));
+
+    IndexFileHeader header = {};
+    std::memcpy(header.magic, indexFileMagic, sizeof(header.magic));
+    header.version = indexFileVersion;
+    header.wordCount = static_cast<std::uint32_t>(index.wordCount());
+    header.clusterCount = static_cast<std::uint32_t>(index.clusterCount());
+    header.blockCount = static_cast<std::uint32_t>(blocks.size());
+    header.blobSize = index.blob.size();
+    header.charCount = batchChars.size();
+    header.tableGroupCount =
+        static_cast<std::uint32_t>(words.lookupTable().size());
+    header.checksum = fnv1a(body);
+
+    const std::string temporaryPath = path + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+
+        if (!file.is_open()) {
+            return -1;
+        }
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(body.data(), static_cast<std::streamsize>(body.size()));
+
+        if (!file) {
+            return -1;
+        }
+    }
+
+    std::error_code renameError;
+    std::filesystem::rename(temporaryPath, path, renameError);
+
+    return renameError ? -1 : 0;
+}
+
+int IndexFile::open(const std::string& path, std::string& error) {
+    indexView = {};
+    lookupTable = {};
+
+    if (file.open(path) != 0) {
+        error = "the file could not be opened";
+        return -1;
+    }
+
+    const std::string_view contents = file.contents();
+    IndexFileHeader header;
+
+    if (contents.size() < sizeof(header)) {
+        error = "the file is too short to be an index file";
+        return -1;
+    }
+
+    std::memcpy(&header, contents.data(), sizeof(header));
+
+    if (std::memcmp(header.magic, indexFileMagic, sizeof(header.magic)) != 0) {
+        error = "the file is not an index file";
+        return -1;
+    }
+
+    if (header.version != indexFileVersion) {
+        error = "unsupported index file version " +
+                std::to_string(header.version);
+        return -1;
+    }
+
+    if (fnv1a(contents.substr(sizeof(header))) != header.checksum) {
+        error = "checksum mismatch, the file is corrupted";
+        return -1;
+    }
+
+    const std::size_t wordCount = header.wordCount;
+    const std::size_t clusterCount = header.clusterCount;
+    SectionReader sections(contents);
+    ClusterIndexView view;
+
+    view.wordOffsets = sections.next<std::uint32_t>(wordCount + 1);
+    view.medoids = sections.next<std::uint32_t>(clusterCount);
+    view.clusterStarts = sections.next<std::uint32_t>(clusterCount + 1);
+    view.members = sections.next<std::uint32_t>(wordCount);
+    view.medoidDistances = sections.next<std::uint32_t>(wordCount);
+    view.radii = sections.next<std::uint32_t>(clusterCount);
+    view.signatures = sections.next<WordSignature>(wordCount);
+
+    const auto blockStarts = sections.next<std::uint32_t>(clusterCount + 2);
+    const auto blocks = sections.next<LevBatchWords::Block>(header.blockCount);
+    const auto batchIds =
+        sections.next<std::uint32_t>(wordCount + clusterCount);
+    const auto batchChars = sections.next<char>(header.charCount);
+    const auto table =
+        sections.next<Dictionary::SlotGroup>(header.tableGroupCount);
+
+    const auto blob = sections.next<char>(header.blobSize);
+    view.blob = std::string_view(blob.data(), blob.size());
+
+    if (!sections.isComplete()) {
+        error = "the file is truncated or has trailing data";
+        return -1;
+    }
+
+    // a matching checksum does not prove the file was written by us, so make
+    // sure no index points outside of the file
+    const auto isWord = [&header](std::uint32_t index) {
+        return index < header.wordCount;
+    };
+
+    if (!isAscending(view.wordOffsets,
+                     static_cast<std::uint32_t>(header.blobSize)) ||
+        !isAscending(view.clusterStarts, header.wordCount) ||
+        !std::all_of(view.medoids.begin(), view.medoids.end(), isWord) ||
+        !std::all_of(view.members.begin(), view.members.end(), isWord)) {
+        error = "the file contains invalid offsets";
+        return -1;
+    }
+
+    // a radius below the distance of a member would make queries miss it
+    for (std::size_t cluster = 0; cluster < view.clusterCount(); cluster++) {
+        for (const auto member : view.cluster(cluster)) {
+            if (view.medoidDistances[member] > view.radii[cluster]) {
+                error = "the file contains a cluster radius that is too small";
+                return -1;
+            }
+        }
+    }
+
+    if (!isValidBatchLayout(view, blockStarts, blocks, batchIds, batchChars)) {
+        error = "the file contains an invalid layout of the batch kernels";
+        return -1;
+    }
+
+    if (!Dictionary::isValidLookupTable(table, wordCount)) {
+        error = "the file contains an invalid lookup table";
+        return -1;
+    }
+
+    std::vector<LevBatchWords::GroupView> groups;
+    groups.reserve(clusterCount + 1);
+
+    for (std::size_t group = 0; group <= clusterCount; group++) {
+        groups.push_back({blocks.subspan(blockStarts[group],
+                                         blockStarts[group + 1] -
+                                             blockStarts[group]),
+                          batchIds.data(), batchChars.data()});
+    }
+
+    indexView = view;
+    lookupTable = table;
+    batches = std::make_unique<LevBatchWords>(std::move(groups));
+    indexView.batches = batches.get();
+
+    return 0;
+}
@@ -0,0 +1,387 @@
+#include "../include/lev_batch.h"
+
+#include "../include/spellchecker.h"
+#include "../include/stats.h"
+
+#include <algorithm>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SPELLCHECKER_X86_64 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(SPELLCHECKER_X86_64)
+#include <intrin.h>
+#endif
+
+// Defined in lev_batch_avx2.cpp, which is the only file built with AVX2
+// enabled. The flag is false when the compiler could not build the kernel
+extern const bool levBatchAvx2Compiled;
+void levBlockAvx2(const char* query, std::size_t querySize, const char* chars,
+                  std::size_t length, std::uint8_t* distances);
+
+namespace {
+
+// All kernels fill the same matrix as levMatrix, with the rows indexed by the
+// query and the columns by the words. Every lane of a vector belongs to a
+// different word of the block, and since the words of a block have the same
+// length all lanes finish at the same column. Values never exceed
+// levBatchMaxLength, so they fit into a byte
+void levBlockScalar(const char* query, std::size_t querySize,
+                    const char* chars, std::size_t length,
+                    std::uint8_t* distances) {
+    std::uint8_t rows[levBatchMaxLength + 1][levBatchLanes];
+
+    for (std::size_t i = 0; i <= querySize; i++) {
+        std::fill_n(rows[i], levBatchLanes, static_cast<std::uint8_t>(i));
+    }
+
+    for (std::size_t j = 0; j < length; j++) {
+        const char* column = chars + j * levBatchLanes;
+
+        for (std::size_t lane = 0; lane < levBatchLanes; lane++) {
+            std::uint8_t diag = rows[0][lane];
+            std::uint8_t left = static_cast<std::uint8_t>(j + 1);
+            rows[0][lane] = left;
+
+            for (std::size_t i = 1; i <= querySize; i++) {
+                const std::uint8_t up = rows[i][lane];
+                const std::uint8_t mismatch = query[i - 1] != column[lane];
+                const std::uint8_t value = std::min<std::uint8_t>(
+                    static_cast<std::uint8_t>(diag + mismatch),
+                    static_cast<std::uint8_t>(std::min(up, left) + 1));
+
+                diag = up;
+                rows[i][lane] = value;
+                left = value;
+            }
+        }
+    }
+
+    std::copy_n(rows[querySize], levBatchLanes, distances);
+}
+
+#ifdef SPELLCHECKER_X86_64
+
+// The 32 lanes are two registers of 16, interleaved so that the CPU can work
+// on both at once
+void levBlockSse2(const char* query, std::size_t querySize, const char* chars,
+                  std::size_t length, std::uint8_t* distances) {
+    __m128i rows[levBatchMaxLength + 1][2];
+    __m128i queryChars[levBatchMaxLength];
+    const __m128i one = _mm_set1_epi8(1);
+
+    for (std::size_t i = 0; i <= querySize; i++) {
+        rows[i][0] = rows[i][1] = _mm_set1_epi8(static_cast<char>(i));
+    }
+
+    for (std::size_t i = 0; i < querySize; i++) {
+        queryChars[i] = _mm_set1_epi8(query[i]);
+    }
+
+    for (std::size_t j = 0; j < length; j++) {
+        const char* column = chars + j * levBatchLanes;
+        const __m128i low =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(column));
+        const __m128i high =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(column + 16));
+
+        __m128i diagLow = rows[0][0];
+        __m128i diagHigh = rows[0][1];
+        __m128i leftLow = _mm_set1_epi8(static_cast<char>(j + 1));
+        __m128i leftHigh = leftLow;
+        rows[0][0] = rows[0][1] = leftLow;
+
+        for (std::size_t i = 1; i <= querySize; i++) {
+            const __m128i upLow = rows[i][0];
+            const __m128i upHigh = rows[i][1];
+            const __m128i mismatchLow = _mm_andnot_si128(
+                _mm_cmpeq_epi8(low, queryChars[i - 1]), one);
+            const __m128i mismatchHigh = _mm_andnot_si128(
+                _mm_cmpeq_epi8(high, queryChars[i - 1]), one);
+
+            leftLow = _mm_min_epu8(
+                _mm_add_epi8(diagLow, mismatchLow),
+                _mm_add_epi8(_mm_min_epu8(upLow, leftLow), one));
+            leftHigh = _mm_min_epu8(
+                _mm_add_epi8(diagHigh, mismatchHigh),
+                _mm_add_epi8(_mm_min_epu8(upHigh, leftHigh), one));
+
+            diagLow = upLow;
+            diagHigh = upHigh;
+            rows[i][0] = leftLow;
+            rows[i][1] = leftHigh;
+        }
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances),
+                     rows[querySize][0]);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(distances + 16),
+                     rows[querySize][1]);
+}
+
+bool cpuSupportsAvx2() {
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, 0, 0);
+
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // the OS has to save the upper halves of the registers as well
+    __cpuidex(info, 1, 0);
+    const bool osSavesAvx = (info[2] & (1 << 27)) != 0 &&
+                            (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(info, 7, 0);
+    return osSavesAvx && (info[1] & (1 << 5)) != 0;
+#else
+    return false;
+#endif
+}
+
+#endif
+
+LevBatchKernel detectKernel() {
+#ifdef SPELLCHECKER_X86_64
+    if (levBatchAvx2Compiled && cpuSupportsAvx2()) {
+        return LevBatchKernel::Avx2;
+    }
+
+    return LevBatchKernel::Sse2;
+#else
+    return LevBatchKernel::Scalar;
+#endif
+}
+
+}  // namespace
+
+LevBatchKernel bestLevBatchKernel() {
+    static const LevBatchKernel best = detectKernel();
+    return best;
+}
+
+bool isLevBatchKernelSupported(LevBatchKernel kernel) {
+    switch (kernel) {
+        case LevBatchKernel::Scalar:
+            return true;
+        case LevBatchKernel::Sse2:
+            return bestLevBatchKernel() != LevBatchKernel::Scalar;
+        case LevBatchKernel::Avx2:
+            return bestLevBatchKernel() == LevBatchKernel::Avx2;
+    }
+
+    return false;
+}
+
+const char* levBatchKernelName(LevBatchKernel kernel) {
+    switch (kernel) {
+        case LevBatchKernel::Scalar:
+            return "scalar";
+        case LevBatchKernel::Sse2:
+            return "sse2";
+        case LevBatchKernel::Avx2:
+            return "avx2";
+    }
+
+    return "unknown";
+}
+
+LevBatchWords::Group LevBatchWords::layOutGroup(
+    std::span<const std::uint32_t> groupIds,
+    std::span<const std::string_view> words) {
+    Group group;
+    std::vector<std::uint32_t> order(words.size());
+    std::iota(order.begin(), order.end(), std::uint32_t{0});
+    std::stable_sort(order.begin(), order.end(),
+                     [&words](std::uint32_t a, std::uint32_t b) {
+                         return words[a].size() < words[b].size();
+                     });
+
+    for (std::size_t first = 0; first < order.size();) {
+        const std::size_t length = words[order[first]].size();
+        std::size_t last = first;
+
+        while (last < order.size() && last - first < levBatchLanes &&
+               words[order[last]].size() == length) {
+            last++;
+        }
+
+        const std::size_t firstChar = group.chars.size();
+        Block block = {static_cast<std::uint32_t>(length),
+                       static_cast<std::uint32_t>(last - first),
+                       static_cast<std::uint32_t>(first),
+                       static_cast<std::uint32_t>(firstChar),
+                       0,
+                       ~std::uint32_t{0}};
+
+        // unused lanes hold zero bytes, their distances are never read
+        group.chars.resize(firstChar + length * levBatchLanes, '\0');
+
+        for (std::size_t lane = 0; lane < block.itemCount; lane++) {
+            const std::string_view word = words[order[first + lane]];
+            const std::uint32_t classes = wordSignature(word).classes;
+
+            block.anyClasses |= classes;
+            block.everyClasses &= classes;
+
+            for (std::size_t j = 0; j < length; j++) {
+                group.chars[firstChar + j * levBatchLanes + lane] = word[j];
+            }
+        }
+
+        group.blocks.push_back(block);
+        first = last;
+    }
+
+    group.ids.reserve(order.size());
+
+    for (const auto position : order) {
+        group.ids.push_back(groupIds[position]);
+    }
+
+    return group;
+}
+
+void LevBatchWords::addGroup(std::span<const std::uint32_t> groupIds,
+                             std::span<const std::string_view> words) {
+    groups.push_back(layOutGroup(groupIds, words));
+    views.push_back(groups.back().view());
+}
+
+void LevBatchWords::setGroup(std::size_t groupIndex,
+                             std::span<const std::uint32_t> groupIds,
+                             std::span<const std::string_view> words) {
+    groups[groupIndex] = layOutGroup(groupIds, words);
+    views[groupIndex] = groups[groupIndex].view();
+}
+
+void LevBatchWords::removeGroup(std::size_t groupIndex) {
+    groups.erase(groups.begin() + static_cast<std::ptrdiff_t>(groupIndex));
+    views.erase(views.begin() + static_cast<std::ptrdiff_t>(groupIndex));
+}
+
+void LevBatchWords::distances(std::string_view query, const GroupView& group,
+                              const Block& block,
+                              std::array<int, levBatchLanes>& results,
+                              LevBatchKernel kernel) {
+    const char* blockChars = group.chars + block.firstChar;
+
+    statsAdd(StatCounter::LevCalls, block.itemCount);
+    statsAdd(StatCounter::LevCells,
+             std::uint64_t{block.itemCount} * block.length * query.size());
+
+    if (query.size() > levBatchMaxLength || block.length > levBatchMaxLength) {
+        std::string word(block.length, '\0');
+
+        for (std::size_t lane = 0; lane < block.itemCount; lane++) {
+            for (std::size_t j = 0; j < block.length; j++) {
+                word[j] = blockChars[j * levBatchLanes + lane];
+            }
+
+            results[lane] = lev(query, word);
+        }
+
+        return;
+    }
+
+    std::uint8_t laneDistances[levBatchLanes];
+
+    switch (kernel) {
+#ifdef SPELLCHECKER_X86_64
+        case LevBatchKernel::Avx2:
+            levBlockAvx2(query.data(), query.size(), blockChars, block.length,
+                         laneDistances);
+            break;
+        case LevBatchKernel::Sse2:
+            levBlockSse2(query.data(), query.size(), blockChars, block.length,
+                         laneDistances);
+            break;
+#endif
+        default:
+            levBlockScalar(query.data(), query.size(), blockChars,
+                           block.length, laneDistances);
+            break;
+    }
+
+    std::copy_n(laneDistances, levBatchLanes, results.begin());
+}
+
+void LevBatchWords::distances(std::string_view query, std::size_t groupIndex,
+                              std::span<int> results,
+                              LevBatchKernel kernel) const {
+    std::array<int, levBatchLanes> laneDistances;
+
+    const GroupView& blocks = group(groupIndex);
+
+    for (const auto& block : blocks) {
+        distances(query, blocks, block, laneDistances, kernel);
+
+        const auto blockIds = blocks.items(block);
+
+        for (std::size_t lane = 0; lane < blockIds.size(); lane++) {
+            results[blockIds[lane]] = laneDistances[lane];
+        }
+    }
+}
+
+std::size_t LevBatchWords::memoryUsage() const {
+    std::size_t bytes = sizeof(*this) + groups.capacity() * sizeof(Group) +
+                        views.capacity() * sizeof(GroupView);
+
+    for (const auto& group : groups) {
+        bytes += group.blocks.capacity() * sizeof(Block) +
+                 group.ids.capacity() * sizeof(std::uint32_t) +
+                 group.chars.capacity();
+    }
+
+    return bytes;
+}
+
+std::vector<int> levBatch(std::string_view query,
+                          const std::vector<std::string>& words) {
+    std::vector<std::uint32_t> ids(words.size());
+    std::iota(ids.begin(), ids.end(), std::uint32_t{0});
+
+    const std::vector<std::string_view> wordViews(words.begin(), words.end());
+
+    LevBatchWords batch;
+    batch.addGroup(ids, wordViews);
+
+    std::vector<int> distances(words.size());
+    batch.distances(query, 0, distances);
+
+    return distances;
+}
+
+LevBatchWords batchClusterIndex(const ClusterIndexView& index) {
+    LevBatchWords batches;
+    std::vector<std::uint32_t> ids(index.clusterCount());
+    std::vector<std::string_view> words;
+
+    std::iota(ids.begin(), ids.end(), std::uint32_t{0});
+
+    for (const auto medoid : index.medoids) {
+        words.push_back(index.word(medoid));
+    }
+
+    batches.addGroup(ids, words);
+
+    for (std::size_t cluster = 0; cluster < index.clusterCount(); cluster++) {
+        const auto members = index.cluster(cluster);
+
+        words.clear();
+
+        for (const auto member : members) {
+            words.push_back(index.word(member));
+        }
+
+        batches.addGroup(members, words);
+    }
+
+    return batches;
+}
@@ -0,0 +1,68 @@
+// This file is built with AVX2 enabled (see CMakeLists.txt), so it must not
+// use anything from the standard library that other files could share: the
+// linker might keep the AVX2 copy of such a function for the whole program.
+// The kernel is only called after bestLevBatchKernel checked the CPU
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+extern const bool levBatchAvx2Compiled = true;
+
+// same as levBlockSse2 in lev_batch.cpp, with all 32 lanes in one register
+void levBlockAvx2(const char* query, std::size_t querySize, const char* chars,
+                  std::size_t length, std::uint8_t* distances) {
+    // levBatchMaxLength, lev_batch.h is not included to keep this file free of
+    // the standard library
+    constexpr std::size_t maxLength = 64;
+    constexpr std::size_t lanes = 32;
+
+    __m256i rows[maxLength + 1];
+    __m256i queryChars[maxLength];
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for (std::size_t i = 0; i <= querySize; i++) {
+        rows[i] = _mm256_set1_epi8(static_cast<char>(i));
+    }
+
+    for (std::size_t i = 0; i < querySize; i++) {
+        queryChars[i] = _mm256_set1_epi8(query[i]);
+    }
+
+    for (std::size_t j = 0; j < length; j++) {
+        const __m256i column = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(chars + j * lanes));
+
+        __m256i diag = rows[0];
+        __m256i left = _mm256_set1_epi8(static_cast<char>(j + 1));
+        rows[0] = left;
+
+        for (std::size_t i = 1; i <= querySize; i++) {
+            const __m256i up = rows[i];
+            const __m256i mismatch = _mm256_andnot_si256(
+                _mm256_cmpeq_epi8(column, queryChars[i - 1]), one);
+
+            left = _mm256_min_epu8(
+                _mm256_add_epi8(diag, mismatch),
+                _mm256_add_epi8(_mm256_min_epu8(up, left), one));
+
+            diag = up;
+            rows[i] = left;
+        }
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(distances),
+                        rows[querySize]);
+}
+
+#else
+
+extern const bool levBatchAvx2Compiled = false;
+
+void levBlockAvx2(const char*, std::size_t, const char*, std::size_t,
+                  std::uint8_t*) {}
+
+#endif
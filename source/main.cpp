@@ -1,63 +1,500 @@
+#include <bktree.h>
+#include <check_file.h>
+#include <cluster_tree.h>
 #include <clustering.h>
+#include <dictionary.h>
+#include <distance_cache.h>
+#include <index_file.h>
+#include <mapped_file.h>
+#include <query_cache.h>
+#include <server.h>
 #include <spellchecker.h>
-
+#include <stats.h>
+#include <symspell.h>
+#include <thread_pool.h>
+#include <trie.h>
+#include <word_file.h>
+
+#include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <list>
+#include <optional>
 #include <ranges>
 #include <span>
+#include <stdexcept>
 #include <string>
 #include <unordered_map>
 
-int readWordsFromFile(std::vector<std::string>& words,
-                      const std::string& filePath);
+/// @brief Lookup structures the program can answer queries with
+enum class Engine {
+    Clusters,  // PAM clusters around medoids
+    BKTree,
+    SymSpell,  // symmetric-delete index, edit distances up to 2
+    ClusterTree,  // clusters split again until they are small enough
+    Trie,         // trie searched like a Levenshtein automaton
+};
+
+// largest edit distance the symmetric-delete index is built for
+constexpr int symSpellMaxDistance = 2;
+
+// queries whose suggestions are kept unless --cache-size says otherwise
+constexpr std::size_t defaultQueryCacheSize = 4096;
+
+// suggestions returned for a query unless --suggestions says otherwise
+constexpr std::size_t defaultSuggestionCount = 5;
+
+int parseEngine(Engine& engine, const std::string& name);
+int parseNumber(std::size_t& number, const std::string& text);
+int parseServerAddress(ServerOptions& options, const std::string& address);
+
+int runBatch(
+    const std::string& queriesPath,
+    const std::function<std::vector<Suggestion>(const std::string&)>& correct,
+    std::ostream& output);
+
+int writeStatsFile(const std::string& path);
 
 void printDistanceMap(const std::unordered_map<std::string, int>& distanceMap);
 void printWelcomeInfo();
 void printClusterRepresentedBy(
     const std::string& representative,
     const std::unordered_map<std::string, int>& cluster);
-void printClusterRepresentedBy(const std::string& representative,
-                               const std::vector<std::string>& cluster);
-void printClusterMap(
-    const std::unordered_map<std::string, std::vector<std::string>>&
-        clusterMap);
-void printListOfWords(const std::vector<std::string>& words);
+void printClusterIndex(const ClusterIndexView& index);
+void printClusterUpdate(const std::string& command, const std::string& word,
+                        const ClusterUpdate& update,
+                        const ClusterIndexView& index);
+void printListOfWords(const std::vector<Suggestion>& suggestions);
 
 int main(int argc, char* argv[]) {
     const std::span<char*> args(argv, static_cast<std::size_t>(argc));
 
-    if (argc < 2) {
+    std::string filePath;
+    std::string buildIndexPath;
+    std::string indexPath;
+    std::string batchPath;
+    std::string checkPath;
+    std::string statsPath;
+    std::optional<ServerOptions> serverOptions;
+    std::size_t cacheSize = defaultQueryCacheSize;
+    std::size_t suggestionCount = defaultSuggestionCount;
+    int maxDistance = std::numeric_limits<int>::max();
+    bool sampledClustering = false;
+    SamplingOptions samplingOptions;
+    ClusterTreeOptions treeOptions;
+    Engine engine = Engine::Clusters;
+
+    for (std::size_t i = 1; i < args.size(); i++) {
+        const std::string arg = args[i];
+
+        if (arg.starts_with("--engine=")) {
+            if (parseEngine(engine, arg.substr(9)) != 0) {
+                return 1;
+            }
+        } else if (arg.starts_with("--build-index=")) {
+            buildIndexPath = arg.substr(14);
+        } else if (arg.starts_with("--index=")) {
+            indexPath = arg.substr(8);
+        } else if (arg.starts_with("--batch=")) {
+            batchPath = arg.substr(8);
+        } else if (arg.starts_with("--serve=")) {
+            serverOptions.emplace();
+
+            if (parseServerAddress(*serverOptions, arg.substr(8)) != 0) {
+                return 1;
+            }
+        } else if (arg.starts_with("--check-file=")) {
+            checkPath = arg.substr(13);
+        } else if (arg.starts_with("--stats=")) {
+            statsPath = arg.substr(8);
+        } else if (arg.starts_with("--threads=")) {
+            std::size_t count = 0;
+
+            if (parseNumber(count, arg.substr(10)) != 0) {
+                std::cerr << "--threads expects a number of threads\n";
+                return 1;
+            }
+
+            // 0 keeps the default of one thread per core
+            ThreadPool::setSharedThreadCount(count);
+        } else if (arg.starts_with("--cache-size=")) {
+            if (parseNumber(cacheSize, arg.substr(13)) != 0) {
+                std::cerr << "--cache-size expects a number of queries\n";
+                return 1;
+            }
+        } else if (arg.starts_with("--suggestions=")) {
+            if (parseNumber(suggestionCount, arg.substr(14)) != 0 ||
+                suggestionCount == 0) {
+                std::cerr << "--suggestions expects a positive number of "
+                             "suggestions\n";
+                return 1;
+            }
+        } else if (arg.starts_with("--max-distance=")) {
+            std::size_t distance = 0;
+
+            if (parseNumber(distance, arg.substr(15)) != 0) {
+                std::cerr << "--max-distance expects an edit distance\n";
+                return 1;
+            }
+
+            // no distance between words of the dictionary gets anywhere near
+            maxDistance = static_cast<int>(std::min<std::size_t>(
+                distance, std::numeric_limits<int>::max()));
+        } else if (arg.starts_with("--clustering=")) {
+            const std::string mode = arg.substr(13);
+
+            if (mode != "exact" && mode != "sampled") {
+                std::cerr << "Unknown clustering \"" << mode
+                          << "\". Available clusterings: exact, sampled\n";
+                return 1;
+            }
+
+            sampledClustering = mode == "sampled";
+        } else if (arg.starts_with("--sample-size=")) {
+            if (parseNumber(samplingOptions.sampleSize, arg.substr(14)) != 0 ||
+                samplingOptions.sampleSize == 0) {
+                std::cerr << "--sample-size expects a positive number of "
+                             "words\n";
+                return 1;
+            }
+        } else if (arg.starts_with("--samples=")) {
+            if (parseNumber(samplingOptions.samples, arg.substr(10)) != 0 ||
+                samplingOptions.samples == 0) {
+                std::cerr << "--samples expects a positive number of "
+                             "samples\n";
+                return 1;
+            }
+        } else if (arg.starts_with("--leaf-size=")) {
+            if (parseNumber(treeOptions.leafSize, arg.substr(12)) != 0 ||
+                treeOptions.leafSize == 0) {
+                std::cerr << "--leaf-size expects a positive number of "
+                             "words\n";
+                return 1;
+            }
+        } else if (arg.starts_with("--branches=")) {
+            if (parseNumber(treeOptions.branches, arg.substr(11)) != 0 ||
+                treeOptions.branches == 0) {
+                std::cerr << "--branches expects a positive number of "
+                             "branches\n";
+                return 1;
+            }
+        } else if (arg.starts_with("--seed=")) {
+            std::size_t seed = 0;
+
+            if (parseNumber(seed, arg.substr(7)) != 0) {
+                std::cerr << "--seed expects a number\n";
+                return 1;
+            }
+
+            samplingOptions.seed = seed;
+        } else if (filePath.empty()) {
+            filePath = arg;
+        } else {
+            std::cerr << "Too many arguments. Only one file allowed\n";
+            return 1;
+        }
+    }
+
+    if (!indexPath.empty()) {
+        if (!filePath.empty() || !buildIndexPath.empty() ||
+            engine != Engine::Clusters) {
+            std::cerr << "--index can not be combined with a word file, "
+                         "--build-index or --engine\n";
+            return 1;
+        }
+    } else if (filePath.empty()) {
         std::cout << "Provide the path to your lexicographical data\n";
         return 1;
-    } else if (argc > 2) {
-        std::cerr << "Too many arguments. Only one file allowed\n";
+    }
+
+    const int modeCount = static_cast<int>(serverOptions.has_value()) +
+                          static_cast<int>(!batchPath.empty()) +
+                          static_cast<int>(!checkPath.empty()) +
+                          static_cast<int>(!buildIndexPath.empty());
+
+    if (modeCount > 1) {
+        std::cerr << "Only one of --serve, --batch, --check-file and "
+                     "--build-index can be used at a time\n";
         return 1;
     }
 
-    const std::string filePath = args[1];
+    // in batch mode the corrections are the only thing written to stdout,
+    // progress messages go to stderr instead
+    std::ostream results(std::cout.rdbuf());
+
+    if (!batchPath.empty() || !checkPath.empty()) {
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
 
-    std::vector<std::string> words;
+    Dictionary words;
 
-    if (readWordsFromFile(words, filePath) != 0) {
-        return -1;
+    if (indexPath.empty()) {
+        if (readWordsFromFile(words, filePath) != 0) {
+            return -1;
+        }
+
+        std::cout << "Done!" << "\n";
     }
 
-    std::cout << "Done!" << "\n";
+    ClusterIndex clusterIndex;
+    IndexFile indexFile;
+    std::optional<BKTree> bkTree;
+    std::optional<ClusterTree> clusterTree;
+    std::optional<SymSpellIndex> symSpellIndex;
+    std::optional<Trie> trie;
+    std::function<std::vector<Suggestion>(const std::string&)> findSuggestions;
 
-    std::cout << "Forming clusters" << "... " << std::flush;
     auto start = std::chrono::high_resolution_clock::now();
-    auto clusterMap = partitionAroundMedoids<std::string>(words, &lev);
-    auto stop = std::chrono::high_resolution_clock::now();
+    auto stop = start;
 
-    const auto sduration =
-        std::chrono::duration_cast<std::chrono::seconds>(stop - start);
+    if (!indexPath.empty()) {
+        std::cout << "Mapping index file at " << indexPath << "... "
+                  << std::flush;
 
-    std::cout << "Done in " << sduration.count() << " s!" << "\n"
-              << "\n";
+        std::string error;
+        start = std::chrono::high_resolution_clock::now();
+
+        if (indexFile.open(indexPath, error) != 0) {
+            std::cerr << "\n"
+                      << "Index file at " << indexPath
+                      << " could not be loaded: " << error << "\n";
+            return -1;
+        }
+
+        stop = std::chrono::high_resolution_clock::now();
+
+        const auto msduration =
+            std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                  start);
+
+        std::cout << "Done in " << msduration.count() << " ms! "
+                  << indexFile.view().wordCount() << " words in "
+                  << indexFile.view().clusterCount() << " clusters" << "\n"
+                  << "\n";
+
+        findSuggestions = [&indexFile, suggestionCount,
+                           maxDistance](const std::string& input) {
+            return suggest(input, indexFile.view(), suggestionCount,
+                           maxDistance);
+        };
+    } else if (engine == Engine::BKTree) {
+        std::cout << "Building BK-tree" << "... " << std::flush;
+        start = std::chrono::high_resolution_clock::now();
+        bkTree.emplace(words);
+        stop = std::chrono::high_resolution_clock::now();
+
+        const auto msduration =
+            std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                  start);
+
+        std::cout << "Done in " << msduration.count() << " ms!" << "\n"
+                  << "\n";
+
+        findSuggestions = [&bkTree, suggestionCount,
+                           maxDistance](const std::string& input) {
+            return bkTree->nearest(input, suggestionCount, maxDistance);
+        };
+    } else if (engine == Engine::ClusterTree) {
+        std::cout << "Forming a tree of clusters" << "... " << std::flush;
+        start = std::chrono::high_resolution_clock::now();
+        treeOptions.sampled = sampledClustering;
+        treeOptions.sampling = samplingOptions;
+        clusterTree.emplace(words, treeOptions);
+        stop = std::chrono::high_resolution_clock::now();
+
+        const auto msduration =
+            std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                  start);
+
+        std::cout << "Done in " << msduration.count() << " ms! "
+                  << clusterTree->leafCount() << " leaves, "
+                  << clusterTree->depth() << " levels, largest leaf "
+                  << clusterTree->largestLeaf() << " words" << "\n"
+                  << "\n";
+
+        findSuggestions = [&clusterTree, suggestionCount,
+                           maxDistance](const std::string& input) {
+            return clusterTree->nearest(input, suggestionCount, maxDistance);
+        };
+    } else if (engine == Engine::Trie) {
+        std::cout << "Building trie" << "... " << std::flush;
+        start = std::chrono::high_resolution_clock::now();
+        trie.emplace(words);
+        stop = std::chrono::high_resolution_clock::now();
+
+        const auto msduration =
+            std::chrono::duration_cast<std::chrono::milliseconds>(stop -
+                                                                  start);
+
+        std::cout << "Done in " << msduration.count() << " ms! "
+                  << trie->nodeCount() << " nodes, "
+                  << trie->memoryUsage() / 1024 << " KiB" << "\n"
+                  << "\n";
+
+        findSuggestions = [&trie, suggestionCount,
+                           maxDistance](const std::string& input) {
+            return trie->nearest(input, suggestionCount, maxDistance);
+        };
+    } else if (engine == Engine::SymSpell) {
+        std::cout << "Building symmetric-delete index" << "... " << std::flush;
+        symSpellIndex.emplace(words, symSpellMaxDistance);
+
+        std::cout << "Done in " << symSpellIndex->buildTime().count()
+                  << " ms! " << symSpellIndex->variantCount()
+                  << " variants, "
+                  << symSpellIndex->memoryUsage() / 1024 << " KiB" << "\n"
+                  << "\n";
+
+        // words further away than the index was built for are not found
+        findSuggestions = [&symSpellIndex, suggestionCount,
+                           maxDistance](const std::string& input) {
+            auto suggestions = symSpellIndex->lookup(
+                input, std::min(maxDistance, symSpellIndex->maxEditDistance()));
+
+            // ordered by distance and rank already
+            if (suggestions.size() > suggestionCount) {
+                suggestions.resize(suggestionCount);
+            }
+
+            return suggestions;
+        };
+    } else {
+        std::cout << "Forming clusters" << "... " << std::flush;
+        start = std::chrono::high_resolution_clock::now();
+        clusterIndex =
+            sampledClustering
+                ? clusterDictionary(std::move(words), samplingOptions)
+                : clusterDictionary(std::move(words));
+        stop = std::chrono::high_resolution_clock::now();
+
+        const auto sduration =
+            std::chrono::duration_cast<std::chrono::seconds>(stop - start);
+
+        std::cout << "Done in " << sduration.count() << " s!" << "\n"
+                  << "\n";
+
+        findSuggestions = [&clusterIndex, suggestionCount,
+                           maxDistance](const std::string& input) {
+            return suggest(input, clusterIndex.view(), suggestionCount,
+                           maxDistance);
+        };
+    }
+
+    // index of a word of the dictionary, npos for anything else. An index
+    // file is probed in place. Removed words are still in the dictionary of
+    // the clusters, but in no cluster
+    const std::function<std::uint32_t(std::string_view)> findWord =
+        [&indexPath, &indexFile, &engine, &clusterIndex,
+         &words](std::string_view word) {
+            if (!indexPath.empty()) {
+                return indexFile.find(word);
+            }
+
+            return engine == Engine::Clusters ? clusterIndex.find(word)
+                                              : words.find(word);
+        };
+
+    // a word of the dictionary is its own correction, it is answered without
+    // a scan. Repeated queries are answered from the cache, without
+    // calculating a single distance
+    QueryCache queryCache(cacheSize);
+    std::function<std::vector<Suggestion>(const std::string&)> correct =
+        [&findWord, &queryCache, &findSuggestions](const std::string& input) {
+            std::vector<Suggestion> suggestions;
+
+            if (const std::uint32_t index = findWord(input);
+                index != Dictionary::npos) {
+                suggestions.push_back({input, 0, index});
+            } else if (!queryCache.find(input, suggestions)) {
+                suggestions = findSuggestions(input);
+                queryCache.insert(input, suggestions);
+            }
+
+            return suggestions;
+        };
+
+    // every query is timed, whatever engine answers it
+    if constexpr (statsEnabled) {
+        correct = [correctUntimed = std::move(correct)](
+                      const std::string& input) {
+            const auto queryStart = std::chrono::steady_clock::now();
+            auto suggestions = correctUntimed(input);
+            const auto queryStop = std::chrono::steady_clock::now();
+
+            statsRecord(StatHistogram::QueryMicroseconds,
+                        static_cast<std::uint64_t>(
+                            std::chrono::duration_cast<
+                                std::chrono::microseconds>(queryStop -
+                                                           queryStart)
+                                .count()));
+
+            return suggestions;
+        };
+    }
+
+    if (!buildIndexPath.empty()) {
+        if (engine != Engine::Clusters) {
+            std::cerr << "Only the pam engine can be saved to an index file\n";
+            return 1;
+        }
+
+        std::cout << "Writing index file to " << buildIndexPath << "... "
+                  << std::flush;
+
+        if (writeIndexFile(buildIndexPath, clusterIndex.view()) != 0) {
+            std::cerr << "\n"
+                      << "Index file at " << buildIndexPath
+                      << " could not be written" << "\n";
+            return -1;
+        }
+
+        std::cout << "Done!" << "\n";
+        return writeStatsFile(statsPath);
+    }
+
+    if (!batchPath.empty()) {
+        const int result = runBatch(batchPath, correct, results);
+        std::cout.rdbuf(results.rdbuf());
+
+        if (writeStatsFile(statsPath) != 0) {
+            return -1;
+        }
+
+        return result;
+    }
+
+    if (!checkPath.empty()) {
+        const int result = checkFile(
+            checkPath,
+            [&findWord](std::string_view token) {
+                return findWord(token) != Dictionary::npos;
+            },
+            correct, results);
+        std::cout.rdbuf(results.rdbuf());
+
+        if (writeStatsFile(statsPath) != 0) {
+            return -1;
+        }
+
+        return result;
+    }
+
+    if (serverOptions) {
+        const int result = runServer(*serverOptions, correct);
+
+        if (writeStatsFile(statsPath) != 0) {
+            return -1;
+        }
+
+        return result;
+    }
 
     std::string input = "";
+    std::vector<std::string> wordList;
 
     std::cout << "Enter your word and the program will try to correct it"
               << "\n"
@@ -66,7 +503,10 @@ int main(int argc, char* argv[]) {
 
     while (true) {
         std::cout << "Word: ";
-        std::cin >> input;
+
+        if (!(std::cin >> input)) {
+            break;
+        }
 
         if (input.length() > 50) {
             std::cout
@@ -83,19 +523,40 @@ int main(int argc, char* argv[]) {
         }
 
         if (input == "/cent") {
+            // the words are kept in an arena, copy them only when they are
+            // actually needed
+            if (wordList.empty() && engine == Engine::Clusters) {
+                const ClusterIndexView& view =
+                    indexPath.empty() ? clusterIndex.view() : indexFile.view();
+
+                // removed words are no longer members of any cluster
+                std::vector<std::uint32_t> indices(view.members.begin(),
+                                                   view.members.end());
+                std::ranges::sort(indices);
+
+                for (const auto index : indices) {
+                    wordList.emplace_back(view.word(index));
+                }
+            } else if (wordList.empty()) {
+                for (std::uint32_t i = 0; i < words.size(); i++) {
+                    wordList.emplace_back(words[i]);
+                }
+            }
+
             std::cout
                 << "Finding the most central word in the original word list"
                 << "... " << std::flush;
 
             const std::string centralWord =
-                findCentralMedoid<std::string>(words, &lev);
+                findCentralMedoid<std::string>(wordList, &lev);
 
             std::cout << "Done!" << "\n";
 
             std::cout << "Calculating distances to all other words" << "... "
                       << std::flush;
 
-            const auto distanceMap = baseListAroundWord(centralWord, words);
+            const auto distanceMap =
+                baseListAroundWord(centralWord, wordList);
             std::cout << "Done!" << "\n";
 
             printClusterRepresentedBy(centralWord, distanceMap);
@@ -104,7 +565,61 @@ int main(int argc, char* argv[]) {
         }
 
         if (input == "/clus") {
-            printClusterMap(clusterMap);
+            if (engine != Engine::Clusters) {
+                std::cout << "No clusters, the program was started with a "
+                             "different engine"
+                          << "\n\n";
+                continue;
+            }
+
+            printClusterIndex(indexPath.empty() ? clusterIndex.view()
+                                                : indexFile.view());
+            continue;
+        }
+
+        if (input == "/add" || input == "/remove") {
+            std::string word;
+
+            if (!(std::cin >> word)) {
+                break;
+            }
+
+            if (engine != Engine::Clusters || !indexPath.empty()) {
+                std::cout << "Words can only be added to or removed from "
+                             "clusters formed at startup"
+                          << "\n\n";
+                continue;
+            }
+
+            if (word.length() > maxWordLength) {
+                std::cout
+                    << "Error: words longer than 50 characters are not allowed"
+                    << "\n\n";
+                continue;
+            }
+
+            // the same as for the words of the file
+            std::ranges::transform(word, word.begin(), [](unsigned char c) {
+                return static_cast<char>(std::tolower(c));
+            });
+
+            const ClusterUpdate update = input == "/add"
+                                             ? clusterIndex.addWord(word)
+                                             : clusterIndex.removeWord(word);
+
+            // cached suggestions may miss the word or still hold it
+            if (update.changed) {
+                queryCache.clear();
+            }
+
+            wordList.clear();
+            printClusterUpdate(input, word, update, clusterIndex.view());
+            continue;
+        }
+
+        if (input == "/stats") {
+            std::cout << "\n";
+            printStats(std::cout, statsSnapshot());
             continue;
         }
 
@@ -116,141 +631,217 @@ int main(int argc, char* argv[]) {
 
         start = std::chrono::high_resolution_clock::now();
 
-        std::vector<std::string> suggestions =
-            findClosestCandidates(input, clusterMap);
+        const std::vector<Suggestion> suggestions = correct(input);
 
         stop = std::chrono::high_resolution_clock::now();
 
         const auto mduration =
             std::chrono::duration_cast<std::chrono::microseconds>(stop - start);
 
-        std::ranges::sort(suggestions,
-                          [&input](const std::string& a, const std::string& b) {
-                              return lev(input, a) < lev(input, b);
-                          });
-
         std::cout << "Corrections (" << mduration.count()
                   << " microseconds):" << "\n";
         printListOfWords(suggestions);
         std::cout << "\n";
     }
 
+    return writeStatsFile(statsPath);
+}
+
+/// @brief Converts the value of the --engine option into an Engine
+/// @param engine engine to be set
+/// @param name name of the engine, "pam", "bktree", "symspell", "tree" or
+/// "trie"
+/// @return 0 on success, -1 if the name is not known
+int parseEngine(Engine& engine, const std::string& name) {
+    if (name == "pam") {
+        engine = Engine::Clusters;
+    } else if (name == "bktree") {
+        engine = Engine::BKTree;
+    } else if (name == "symspell") {
+        engine = Engine::SymSpell;
+    } else if (name == "tree") {
+        engine = Engine::ClusterTree;
+    } else if (name == "trie") {
+        engine = Engine::Trie;
+    } else {
+        std::cerr << "Unknown engine \"" << name
+                  << "\". Available engines: pam, bktree, symspell, "
+                     "tree, trie\n";
+        return -1;
+    }
+
     return 0;
 }
 
-/// @brief Reads all lines from a file into the list of words
-/// @param words list of words to be populated
-/// @param filePath path to the file to read from
-/// @return 0 on success, -1 if something went wrong
-int readWordsFromFile(std::vector<std::string>& words,
-                      const std::string& filePath) {
-    std::cout << "Reading file at " << filePath << " ... \n\n" << std::flush;
+/// @brief Converts the value of a numeric option
+/// @param number number to be set
+/// @param text decimal digits
+/// @return 0 on success, -1 if the text is not a number that fits
+int parseNumber(std::size_t& number, const std::string& text) {
+    if (text.empty() || !std::ranges::all_of(text, [](unsigned char c) {
+            return std::isdigit(c) != 0;
+        })) {
+        return -1;
+    }
 
-    std::ifstream file(filePath);
+    try {
+        number = std::stoul(text);
+    } catch (const std::out_of_range&) {
+        return -1;
+    }
 
-    if (!file.is_open()) {
-        std::cerr << "File at " << filePath << " could not be opened"
-                  << "\n";
+    return 0;
+}
+
+/// @brief Converts the value of the --serve option into ServerOptions
+/// @param options options to be set
+/// @param address "unix:<path>" or "tcp:<port>"
+/// @return 0 on success, -1 if the address is not understood
+int parseServerAddress(ServerOptions& options, const std::string& address) {
+    std::size_t port = 0;
+
+    if (address.starts_with("unix:") && address.size() > 5) {
+        options.socketPath = address.substr(5);
+    } else if (address.starts_with("tcp:") &&
+               parseNumber(port, address.substr(4)) == 0 && port <= 65535) {
+        options.port = static_cast<std::uint16_t>(port);
+    } else {
+        std::cerr << "--serve expects unix:<path> or tcp:<port>\n";
         return -1;
     }
 
-    std::string line;
+    return 0;
+}
 
-    std::ofstream duplicateLog;
-    std::ofstream longLog;
+/// @brief Corrects every line of a file (or of stdin when the path is "-") and
+/// writes "query<TAB>suggestion,suggestion,..." for each of them, in input
+/// order. Repeated queries are corrected once and all unique queries are
+/// corrected in parallel, so correct has to be safe to call from several
+/// threads
+/// @param queriesPath path to the file with one query per line, or "-"
+/// @param correct function returning the corrections of a query, closest first
+/// @param output stream the corrections are written to
+/// @return 0 on success, -1 if the queries could not be read
+int runBatch(
+    const std::string& queriesPath,
+    const std::function<std::vector<Suggestion>(const std::string&)>& correct,
+    std::ostream& output) {
+    MappedFile queriesFile;
+    std::string standardInput;
+    std::string_view contents;
+
+    if (queriesPath == "-") {
+        standardInput.assign(std::istreambuf_iterator<char>(std::cin),
+                             std::istreambuf_iterator<char>());
+        contents = standardInput;
+    } else {
+        if (queriesFile.open(queriesPath) != 0) {
+            std::cerr << "File at " << queriesPath << " could not be opened"
+                      << "\n";
+            return -1;
+        }
 
-    int longCounter = 0;
-    bool longLimitExceeded = false;
+        contents = queriesFile.contents();
+    }
 
-    int repeatedCounter = 0;
-    bool repeatedLimitExceeded = false;
+    const auto start = std::chrono::high_resolution_clock::now();
 
-    std::unordered_set<std::string> loadedWords;
+    // every line refers to its query in the list of unique ones
+    std::vector<std::string_view> uniqueQueries;
+    std::vector<std::size_t> lineQueries;
+    std::unordered_map<std::string_view, std::size_t> queryIndices;
 
-    while (getline(file, line)) {
-        if (line.size() > 50) {
-            longCounter++;
+    for (const auto line : std::views::split(contents, '\n')) {
+        std::string_view query(line.begin(), line.end());
 
-            if (!longLimitExceeded) {
-                if (longCounter <= 10) {
-                    if (!longLog.is_open()) {
-                        longLog.open("too_long_words.txt");
+        if (query.ends_with('\r')) {
+            query.remove_suffix(1);
+        }
 
-                        std::cout << "Logging too-long words to "
-                                     "'too_long_words.txt'.\n";
-                    }
-                    longLog << line << "\n";
-
-                    std::cout
-                        << "Word exceeds 50 characters: \"" << line
-                        << "\".\n"
-                           "Words longer than 50 characters are not allowed. "
-                           "Skipping.\n\n";
-                } else {
-                    longLimitExceeded = true;
-                    std::cout
-                        << "More than 10 words exceed 50 characters. Further "
-                           "messages will be suppressed.\n\n";
-                }
-            }
+        if (query.empty()) {
             continue;
         }
 
-        std::string lowerCaseLine = line;
-        std::transform(lowerCaseLine.begin(), lowerCaseLine.end(),
-                       lowerCaseLine.begin(), [](unsigned char c) {
-                           return static_cast<unsigned char>(std::tolower(c));
-                       });
+        const auto [position, inserted] =
+            queryIndices.emplace(query, uniqueQueries.size());
 
-        if (loadedWords.contains(lowerCaseLine)) {
-            repeatedCounter++;
+        if (inserted) {
+            uniqueQueries.push_back(query);
+        }
 
-            if (!duplicateLog.is_open()) {
-                duplicateLog.open("duplicates.txt");
-                std::cout << "Logging duplicate words to 'duplicates.txt'.\n";
-            }
+        lineQueries.push_back(position->second);
+    }
 
-            duplicateLog << line << "\n";
+    std::vector<std::string> corrections(uniqueQueries.size());
 
-            if (!repeatedLimitExceeded) {
-                if (repeatedCounter <= 15) {
-                    std::cout << "Duplicate word found: \"" << line
-                              << "\". Skipping.\n\n";
-                } else {
-                    repeatedLimitExceeded = true;
-                    std::cout << "More than 15 duplicate words found. Further "
-                                 "messages will be suppressed.\n\n";
-                }
-            }
-            continue;
-        }
+    parallelFor(uniqueQueries.size(), 16,
+                [&uniqueQueries, &corrections, &correct](
+                    std::size_t chunkBegin, std::size_t chunkEnd) {
+                    for (std::size_t i = chunkBegin; i < chunkEnd; i++) {
+                        const std::string query(uniqueQueries[i]);
 
-        loadedWords.insert(lowerCaseLine);
-    }
+                        if (query.length() > 50) {
+                            continue;
+                        }
 
-    if (duplicateLog.is_open()) {
-        duplicateLog.close();
-        std::cout << "Duplicates logged to 'duplicates.txt'\n";
-    }
+                        // same order as in the interactive mode
+                        for (const auto& suggestion : correct(query)) {
+                            if (!corrections[i].empty()) {
+                                corrections[i] += ',';
+                            }
 
-    if (longLog.is_open()) {
-        longLog.close();
-        std::cout << "Long words logged to 'too_long_words.txt'\n";
+                            corrections[i] += suggestion.word;
+                        }
+                    }
+                });
+
+    // written in large blocks instead of line by line
+    const std::size_t blockSize = std::size_t{1} << 20;
+    std::string block;
+    block.reserve(blockSize + 256);
+
+    for (const auto query : lineQueries) {
+        block += uniqueQueries[query];
+        block += '\t';
+        block += corrections[query];
+        block += '\n';
+
+        if (block.size() >= blockSize) {
+            output.write(block.data(), static_cast<std::streamsize>(block.size()));
+            block.clear();
+        }
     }
 
-    file.close();
+    output.write(block.data(), static_cast<std::streamsize>(block.size()));
+    output.flush();
+
+    const auto stop = std::chrono::high_resolution_clock::now();
+    const auto msduration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+
+    std::cerr << "Corrected " << lineQueries.size() << " queries ("
+              << uniqueQueries.size() << " unique) in " << msduration.count()
+              << " ms" << "\n";
+
+    return 0;
+}
+
+/// @brief Writes the statistics collected so far into a JSON file
+/// @param path path of the file, nothing is written if it is empty
+/// @return 0 on success, -1 if the file could not be written
+int writeStatsFile(const std::string& path) {
+    if (path.empty()) {
+        return 0;
+    }
 
-    words = std::vector(loadedWords.begin(), loadedWords.end());
+    std::ofstream file(path);
 
-    if (words.empty()) {
-        std::cerr << "\n"
-                  << "File at " << filePath << " was empty" << "\n";
+    if (!file.is_open()) {
+        std::cerr << "File at " << path << " could not be opened" << "\n";
         return -1;
     }
 
-    std::cout << "Skipped " << longCounter
-              << " word(s) longer than 50 characters\n";
-    std::cout << "Skipped " << repeatedCounter << " duplicate word(s)\n\n";
+    writeStatsJson(file, statsSnapshot());
 
     return 0;
 }
@@ -273,6 +864,15 @@ void printWelcomeInfo() {
               << "\n";
     std::cout << "/clus - print the clusters found by the program" << "\n"
               << "\n";
+    std::cout << "/add <word> - add a word to the cluster of its nearest "
+                 "medoid"
+              << "\n"
+              << "\n";
+    std::cout << "/remove <word> - remove a word from its cluster" << "\n"
+              << "\n";
+    std::cout << "/stats - print the counters and histograms collected so far"
+              << "\n"
+              << "\n";
     std::cout << "/help - print this information again" << "\n"
               << "\n";
 }
@@ -288,34 +888,56 @@ void printClusterRepresentedBy(
     std::cout << "\n";
 }
 
-void printClusterRepresentedBy(const std::string& representative,
-                               const std::vector<std::string>& cluster) {
-    std::cout << "\n" << representative << ":" << "\n";
-    for (const auto& wordDistancePair : cluster) {
-        std::cout << "\t" << wordDistancePair << "\n";
-    }
+void printClusterIndex(const ClusterIndexView& index) {
     std::cout << "\n";
-}
 
-void printClusterMap(
-    const std::unordered_map<std::string, std::vector<std::string>>&
-        clusterMap) {
-    std::cout << "\n";
+    for (std::size_t cluster = 0; cluster < index.clusterCount(); cluster++) {
+        const auto members = index.cluster(cluster);
 
-    for (const auto& wordClusterPair : clusterMap) {
-        std::cout << wordClusterPair.first << " ("
-                  << wordClusterPair.second.size() << "):" << "\n";
+        std::cout << index.word(index.medoids[cluster]) << " ("
+                  << members.size() << "):" << "\n";
 
-        for (const auto& word : wordClusterPair.second) {
-            std::cout << "\t" << word << "\n";
+        for (const auto member : members) {
+            std::cout << "\t" << index.word(member) << "\n";
         }
     }
 
     std::cout << "\n";
 }
 
-void printListOfWords(const std::vector<std::string>& words) {
-    for (const auto& word : words) {
-        std::cout << "\t" << word << "\n";
+void printListOfWords(const std::vector<Suggestion>& suggestions) {
+    for (const auto& suggestion : suggestions) {
+        std::cout << "\t" << suggestion.word << " (" << suggestion.distance
+                  << ")\n";
+    }
+}
+
+void printClusterUpdate(const std::string& command, const std::string& word,
+                        const ClusterUpdate& update,
+                        const ClusterIndexView& index) {
+    if (!update.changed) {
+        std::cout << "\"" << word << "\""
+                  << (command == "/add" ? " is already in the dictionary"
+                                        : " is not in the dictionary")
+                  << "\n\n";
+        return;
     }
+
+    if (update.clusterRemoved) {
+        std::cout << "Removed \"" << word
+                  << "\", it was the last word of its cluster" << "\n\n";
+        return;
+    }
+
+    std::cout << (command == "/add" ? "Added \"" : "Removed \"") << word
+              << (command == "/add" ? "\" to" : "\" from")
+              << " the cluster of \""
+              << index.word(index.medoids[update.cluster]) << "\" ("
+              << index.cluster(update.cluster).size() << " words)";
+
+    if (update.medoidChosen) {
+        std::cout << ", its medoid was chosen again";
+    }
+
+    std::cout << "\n\n";
 }
@@ -0,0 +1,159 @@
+#include "../include/mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#else
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+
+        data = std::exchange(other.data, nullptr);
+        size = std::exchange(other.size, 0);
+
+#ifdef _WIN32
+        fileHandle = std::exchange(other.fileHandle, nullptr);
+        mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+    }
+
+    return *this;
+}
+
+#ifdef _WIN32
+
+int MappedFile::open(const std::string& path) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        return -1;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return -1;
+    }
+
+    fileHandle = file;
+
+    // an empty file cannot be mapped, but it is still a valid (empty) file
+    if (fileSize.QuadPart == 0) {
+        return 0;
+    }
+
+    HANDLE mapping =
+        CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+    if (mapping == nullptr) {
+        close();
+        return -1;
+    }
+
+    mappingHandle = mapping;
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (view == nullptr) {
+        close();
+        return -1;
+    }
+
+    data = static_cast<const char*>(view);
+    size = static_cast<std::size_t>(fileSize.QuadPart);
+
+    return 0;
+}
+
+void MappedFile::close() {
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+    }
+
+    if (mappingHandle != nullptr) {
+        CloseHandle(mappingHandle);
+    }
+
+    if (fileHandle != nullptr) {
+        CloseHandle(fileHandle);
+    }
+
+    data = nullptr;
+    size = 0;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+}
+
+#else
+
+int MappedFile::open(const std::string& path) {
+    close();
+
+    const int descriptor = ::open(path.c_str(), O_RDONLY);
+
+    if (descriptor < 0) {
+        return -1;
+    }
+
+    struct stat status;
+
+    if (fstat(descriptor, &status) != 0) {
+        ::close(descriptor);
+        return -1;
+    }
+
+    // an empty file cannot be mapped, but it is still a valid (empty) file
+    if (status.st_size == 0) {
+        ::close(descriptor);
+        return 0;
+    }
+
+    const std::size_t fileSize = static_cast<std::size_t>(status.st_size);
+    void* view =
+        mmap(nullptr, fileSize, PROT_READ, MAP_SHARED, descriptor, 0);
+
+    // the mapping keeps its own reference to the file
+    ::close(descriptor);
+
+    if (view == MAP_FAILED) {
+        return -1;
+    }
+
+    data = static_cast<const char*>(view);
+    size = fileSize;
+
+    return 0;
+}
+
+void MappedFile::close() {
+    if (data != nullptr) {
+        munmap(const_cast<char*>(data), size);
+    }
+
+    data = nullptr;
+    size = 0;
+}
+
+#endif
@@ -0,0 +1,223 @@
+#include "../include/query_cache.h"
+
+#include "../include/stats.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace {
+
+// the shard of a query is picked by the top bits of its hash, among at most
+// shardCount shards
+constexpr std::size_t shardCount = 16;
+
+// the sketch has 4 rows of counters per cached query, and its counters are
+// halved after 10 additions per cached query so old popularity fades
+constexpr std::size_t sketchRows = 4;
+constexpr std::size_t sketchCountersPerQuery = 4;
+constexpr std::size_t sketchSamplesPerQuery = 10;
+constexpr std::uint8_t sketchMaxCount = 15;
+
+std::uint64_t queryHash(std::string_view query) {
+    // std::hash of a string is not required to mix its bits, the rows of the
+    // sketch and the shards need all of them
+    std::uint64_t hash = std::hash<std::string_view>{}(query);
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDull;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
+// Count-min sketch of the query frequencies. Every row counts a query at a
+// different position, the smallest of its counters is the estimate
+class FrequencySketch {
+public:
+    explicit FrequencySketch(std::size_t queries) {
+        std::size_t width = 16;
+
+        while (width < sketchCountersPerQuery * queries) {
+            width *= 2;
+        }
+
+        counters.assign(sketchRows * width, 0);
+        mask = width - 1;
+        sampleSize = sketchSamplesPerQuery * queries;
+    }
+
+    void increment(std::uint64_t hash) {
+        for (std::size_t row = 0; row < sketchRows; row++) {
+            std::uint8_t& counter = counters[position(hash, row)];
+
+            if (counter < sketchMaxCount) {
+                counter++;
+            }
+        }
+
+        if (++additions >= sampleSize) {
+            for (auto& counter : counters) {
+                counter /= 2;
+            }
+
+            additions /= 2;
+        }
+    }
+
+    std::uint8_t estimate(std::uint64_t hash) const {
+        std::uint8_t count = sketchMaxCount;
+
+        for (std::size_t row = 0; row < sketchRows; row++) {
+            count = std::min(count, counters[position(hash, row)]);
+        }
+
+        return count;
+    }
+
+private:
+    // double hashing: row r looks at h1 + r * h2
+    std::size_t position(std::uint64_t hash, std::size_t row) const {
+        const std::uint64_t step = (hash >> 32) | 1;
+
+        return row * (mask + 1) +
+               static_cast<std::size_t>((hash + row * step) & mask);
+    }
+
+    std::vector<std::uint8_t> counters;
+    std::size_t mask;
+    std::size_t sampleSize;
+    std::size_t additions = 0;
+};
+
+}  // namespace
+
+struct alignas(64) QueryCache::Shard {
+    struct Entry {
+        std::string query;
+        std::uint64_t hash;
+        std::vector<Suggestion> suggestions;
+    };
+
+    explicit Shard(std::size_t shardCapacity)
+        : capacity(shardCapacity), sketch(shardCapacity) {}
+
+    std::mutex mutex;
+    std::size_t capacity;
+    FrequencySketch sketch;
+
+    // most recently used first. The keys of the positions point into the
+    // entries, which never move while they are in the list
+    std::list<Entry> entries;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> positions;
+};
+
+QueryCache::QueryCache(std::size_t capacity) : totalCapacity(capacity) {
+    if (capacity == 0) {
+        return;
+    }
+
+    // a cache smaller than shardCount gets a shard per query, and the first
+    // capacity % shardCount shards of a larger one get one query more, so the
+    // shards hold exactly capacity queries together
+    const std::size_t count = std::min(capacity, shardCount);
+
+    shards.reserve(count);
+
+    for (std::size_t i = 0; i < count; i++) {
+        const std::size_t extra = i < capacity % count ? 1 : 0;
+
+        shards.push_back(std::make_unique<Shard>(capacity / count + extra));
+    }
+}
+
+QueryCache::~QueryCache() = default;
+
+QueryCache::Shard& QueryCache::shardOf(std::uint64_t hash) const {
+    return *shards[((hash >> 32) * shards.size()) >> 32];
+}
+
+bool QueryCache::find(std::string_view query,
+                      std::vector<Suggestion>& suggestions) {
+    if (shards.empty()) {
+        return false;
+    }
+
+    const std::uint64_t hash = queryHash(query);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    shard.sketch.increment(hash);
+
+    const auto position = shard.positions.find(query);
+
+    if (position == shard.positions.end()) {
+        statsAdd(StatCounter::CacheMisses);
+        return false;
+    }
+
+    shard.entries.splice(shard.entries.begin(), shard.entries,
+                         position->second);
+    suggestions = position->second->suggestions;
+    statsAdd(StatCounter::CacheHits);
+
+    return true;
+}
+
+void QueryCache::insert(std::string_view query,
+                        const std::vector<Suggestion>& suggestions) {
+    if (shards.empty()) {
+        return;
+    }
+
+    const std::uint64_t hash = queryHash(query);
+    Shard& shard = shardOf(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // another thread may have missed the same query at the same time
+    if (shard.positions.contains(query)) {
+        return;
+    }
+
+    if (shard.entries.size() >= shard.capacity) {
+        const Shard::Entry& victim = shard.entries.back();
+
+        if (shard.sketch.estimate(hash) <= shard.sketch.estimate(victim.hash)) {
+            statsAdd(StatCounter::CacheRejections);
+            return;
+        }
+
+        shard.positions.erase(victim.query);
+        shard.entries.pop_back();
+        statsAdd(StatCounter::CacheEvictions);
+    }
+
+    shard.entries.push_front({std::string(query), hash, suggestions});
+    shard.positions.emplace(shard.entries.front().query,
+                            shard.entries.begin());
+}
+
+void QueryCache::clear() {
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+
+        shard->positions.clear();
+        shard->entries.clear();
+    }
+}
+
+std::size_t QueryCache::size() const {
+    std::size_t cached = 0;
+
+    for (const auto& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard->mutex);
+        cached += shard->entries.size();
+    }
+
+    return cached;
+}
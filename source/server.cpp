@@ -0,0 +1,712 @@
+#include "../include/server.h"
+
+#ifdef __linux__
+
+#include "../include/stats.h"
+#include "../include/thread_pool.h"
+#include "../include/word_file.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// a client sending a longer line without a newline is disconnected
+constexpr std::size_t maxLineLength = 4096;
+
+// a connection is not read from while it has this many queries being
+// corrected, or this much output the client has not taken yet
+constexpr std::size_t maxPendingQueries = 256;
+constexpr std::size_t maxBufferedOutput = std::size_t{1} << 20;
+
+constexpr std::size_t readSize = std::size_t{64} << 10;
+constexpr int maxEvents = 256;
+
+// epoll tags the listening socket and the two eventfds with these, and every
+// connection with an id of its own that is never reused
+constexpr std::uint64_t listenerTag = 0;
+constexpr std::uint64_t completionsTag = 1;
+constexpr std::uint64_t stopTag = 2;
+constexpr std::uint64_t firstConnectionId = 3;
+
+// written by the signal handler, which can not touch anything else
+std::atomic<int> stopEvent = -1;
+
+void requestStop(int) {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const auto written =
+        write(stopEvent.load(), &one, sizeof(one));
+}
+
+void signalEvent(int event) {
+    const std::uint64_t one = 1;
+    [[maybe_unused]] const auto written = write(event, &one, sizeof(one));
+}
+
+void clearEvent(int event) {
+    std::uint64_t count = 0;
+    [[maybe_unused]] const auto bytesRead = read(event, &count, sizeof(count));
+}
+
+class EventLoop {
+public:
+    EventLoop(
+        const std::function<std::vector<Suggestion>(const std::string&)>&
+            correctQuery)
+        : correct(correctQuery) {}
+
+    ~EventLoop() {
+        for (const auto& [id, connection] : connections) {
+            close(connection.socket);
+        }
+
+        for (const int descriptor : {listener, completionsEvent, epoll}) {
+            if (descriptor >= 0) {
+                close(descriptor);
+            }
+        }
+
+        if (!socketPath.empty()) {
+            unlink(socketPath.c_str());
+        }
+    }
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    int listen(const ServerOptions& options);
+    int run(int stop);
+
+private:
+    struct Connection {
+        int socket = -1;
+        std::string input;
+        std::string output;
+        std::size_t outputSent = 0;
+        std::uint32_t events = EPOLLIN;
+        bool readClosed = false;
+
+        // queries are numbered in the order they arrive, answers that are
+        // ready before the ones of earlier queries wait in finished
+        std::uint64_t nextQuery = 0;
+        std::uint64_t nextAnswer = 0;
+        std::map<std::uint64_t, std::string> finished;
+    };
+
+    struct Completion {
+        std::uint64_t connection;
+        std::uint64_t query;
+        std::string answer;
+    };
+
+    void acceptConnections();
+    void readFrom(std::uint64_t id, Connection& connection);
+    void parseQueries(std::uint64_t id, Connection& connection);
+    void dispatch(std::uint64_t id, Connection& connection,
+                  std::string_view query);
+    void collectCompletions();
+    void writeTo(std::uint64_t id, Connection& connection);
+    void update(std::uint64_t id, Connection& connection);
+    void closeConnection(std::uint64_t id);
+    bool watch(int descriptor, std::uint32_t events, std::uint64_t tag);
+
+    static bool acceptsQueries(const Connection& connection) {
+        return connection.nextQuery - connection.nextAnswer <
+                   maxPendingQueries &&
+               connection.output.size() - connection.outputSent <
+                   maxBufferedOutput;
+    }
+
+    const std::function<std::vector<Suggestion>(const std::string&)>& correct;
+
+    int epoll = -1;
+    int listener = -1;
+    int completionsEvent = -1;
+    bool listenerPaused = false;
+    std::string socketPath;
+
+    std::unordered_map<std::uint64_t, Connection> connections;
+    std::uint64_t nextConnectionId = firstConnectionId;
+    std::size_t queriesInFlight = 0;
+    std::size_t queriesAnswered = 0;
+
+    // filled by the workers, emptied by the loop
+    std::mutex completionsMutex;
+    std::vector<Completion> completions;
+};
+
+bool EventLoop::watch(int descriptor, std::uint32_t events,
+                      std::uint64_t tag) {
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = tag;
+
+    return epoll_ctl(epoll, EPOLL_CTL_ADD, descriptor, &event) == 0;
+}
+
+int EventLoop::listen(const ServerOptions& options) {
+    epoll = epoll_create1(EPOLL_CLOEXEC);
+    completionsEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (epoll < 0 || completionsEvent < 0) {
+        std::cerr << "Event loop could not be created: "
+                  << std::strerror(errno) << "\n";
+        return -1;
+    }
+
+    if (!options.socketPath.empty()) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+
+        if (options.socketPath.size() >= sizeof(address.sun_path)) {
+            std::cerr << "Socket path " << options.socketPath
+                      << " is too long" << "\n";
+            return -1;
+        }
+
+        // a socket left behind by a server that did not shut down is
+        // replaced, any other file is not
+        struct stat status = {};
+
+        if (lstat(options.socketPath.c_str(), &status) == 0) {
+            if (!S_ISSOCK(status.st_mode)) {
+                std::cerr << "File at " << options.socketPath
+                          << " exists and is not a socket" << "\n";
+                return -1;
+            }
+
+            unlink(options.socketPath.c_str());
+        }
+
+        std::ranges::copy(options.socketPath, address.sun_path);
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+
+        if (listener < 0 ||
+            bind(listener, reinterpret_cast<const sockaddr*>(&address),
+                 sizeof(address)) != 0) {
+            std::cerr << "Socket at " << options.socketPath
+                      << " could not be created: " << std::strerror(errno)
+                      << "\n";
+            return -1;
+        }
+
+        socketPath = options.socketPath;
+    } else {
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options.port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+        const int reuse = 1;
+
+        if (listener < 0 ||
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                       sizeof(reuse)) != 0 ||
+            bind(listener, reinterpret_cast<const sockaddr*>(&address),
+                 sizeof(address)) != 0) {
+            std::cerr << "Port " << options.port
+                      << " could not be bound: " << std::strerror(errno)
+                      << "\n";
+            return -1;
+        }
+    }
+
+    if (::listen(listener, SOMAXCONN) != 0 ||
+        !watch(listener, EPOLLIN, listenerTag) ||
+        !watch(completionsEvent, EPOLLIN, completionsTag)) {
+        std::cerr << "Socket could not be listened on: "
+                  << std::strerror(errno) << "\n";
+        return -1;
+    }
+
+    if (socketPath.empty()) {
+        sockaddr_in address = {};
+        socklen_t length = sizeof(address);
+        getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length);
+
+        std::cout << "Listening on 127.0.0.1:" << ntohs(address.sin_port)
+                  << "\n";
+    } else {
+        std::cout << "Listening on " << socketPath << "\n";
+    }
+
+    return 0;
+}
+
+int EventLoop::run(int stop) {
+    if (!watch(stop, EPOLLIN, stopTag)) {
+        std::cerr << "Event loop could not be set up: "
+                  << std::strerror(errno) << "\n";
+        return -1;
+    }
+
+    const auto start = std::chrono::high_resolution_clock::now();
+    std::size_t connectionCount = 0;
+    bool stopping = false;
+    std::array<epoll_event, maxEvents> events;
+
+    // queries still being corrected hold a pointer to the loop, so it keeps
+    // collecting them after a stop
+    while (!stopping || queriesInFlight > 0) {
+        const int ready = epoll_wait(epoll, events.data(), maxEvents, -1);
+
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (ready < 0) {
+            std::cerr << "Event loop failed: " << std::strerror(errno) << "\n";
+            return -1;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            const epoll_event& event = events[static_cast<std::size_t>(i)];
+            const std::uint64_t tag = event.data.u64;
+
+            if (tag == stopTag) {
+                clearEvent(stop);
+
+                // no new queries, the answers of the running ones are dropped
+                stopping = true;
+                epoll_ctl(epoll, EPOLL_CTL_DEL, listener, nullptr);
+
+                while (!connections.empty()) {
+                    closeConnection(connections.begin()->first);
+                }
+
+                continue;
+            }
+
+            if (tag == completionsTag) {
+                collectCompletions();
+                continue;
+            }
+
+            if (tag == listenerTag) {
+                const std::size_t before = connections.size();
+                acceptConnections();
+                connectionCount += connections.size() - before;
+                continue;
+            }
+
+            // closed earlier in this batch of events
+            const auto position = connections.find(tag);
+
+            if (position == connections.end()) {
+                continue;
+            }
+
+            Connection& connection = position->second;
+
+            if ((event.events & (EPOLLERR | EPOLLHUP)) != 0 &&
+                (event.events & EPOLLIN) == 0) {
+                closeConnection(tag);
+                continue;
+            }
+
+            if ((event.events & EPOLLOUT) != 0) {
+                writeTo(tag, connection);
+
+                if (!connections.contains(tag)) {
+                    continue;
+                }
+            }
+
+            if ((event.events & EPOLLIN) != 0) {
+                readFrom(tag, connection);
+            }
+        }
+    }
+
+    const auto stopTime = std::chrono::high_resolution_clock::now();
+    const auto msduration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stopTime -
+                                                              start);
+
+    std::cout << "Answered " << queriesAnswered << " queries on "
+              << connectionCount << " connections in " << msduration.count()
+              << " ms" << "\n";
+
+    return 0;
+}
+
+void EventLoop::acceptConnections() {
+    while (true) {
+        const int client =
+            accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (client < 0) {
+            // out of descriptors: the listener is left alone until a
+            // connection closes, or the loop would spin on it
+            if (errno == EMFILE || errno == ENFILE) {
+                epoll_ctl(epoll, EPOLL_CTL_DEL, listener, nullptr);
+                listenerPaused = true;
+            }
+
+            return;
+        }
+
+        const std::uint64_t id = nextConnectionId++;
+
+        if (!watch(client, EPOLLIN, id)) {
+            close(client);
+            continue;
+        }
+
+        connections[id].socket = client;
+    }
+}
+
+void EventLoop::readFrom(std::uint64_t id, Connection& connection) {
+    // one read per event keeps a fast client from starving the others, the
+    // rest is still there on the next round
+    std::array<char, readSize> buffer;
+    const ssize_t bytesRead = recv(connection.socket, buffer.data(),
+                                   buffer.size(), 0);
+
+    if (bytesRead < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            closeConnection(id);
+        }
+
+        return;
+    }
+
+    if (bytesRead == 0) {
+        connection.readClosed = true;
+    } else {
+        connection.input.append(buffer.data(),
+                                static_cast<std::size_t>(bytesRead));
+    }
+
+    parseQueries(id, connection);
+}
+
+void EventLoop::parseQueries(std::uint64_t id, Connection& connection) {
+    std::size_t parsed = 0;
+
+    while (acceptsQueries(connection)) {
+        const std::size_t end = connection.input.find('\n', parsed);
+
+        // like the last line of a file, a query needs no newline before the
+        // client stops sending
+        if (end == std::string::npos && !connection.readClosed) {
+            break;
+        }
+
+        const std::size_t lineEnd =
+            end == std::string::npos ? connection.input.size() : end;
+        std::string_view query(connection.input.data() + parsed,
+                               lineEnd - parsed);
+
+        if (query.ends_with('\r')) {
+            query.remove_suffix(1);
+        }
+
+        if (!query.empty()) {
+            dispatch(id, connection, query);
+        }
+
+        parsed = end == std::string::npos ? lineEnd : end + 1;
+
+        if (parsed == connection.input.size()) {
+            break;
+        }
+    }
+
+    connection.input.erase(0, parsed);
+
+    if (connection.input.size() > maxLineLength &&
+        connection.input.find('\n') == std::string::npos) {
+        closeConnection(id);
+        return;
+    }
+
+    update(id, connection);
+}
+
+void EventLoop::dispatch(std::uint64_t id, Connection& connection,
+                         std::string_view query) {
+    const std::uint64_t number = connection.nextQuery++;
+    const auto arrival = std::chrono::high_resolution_clock::now();
+
+    queriesInFlight++;
+
+    ThreadPool::shared().submit([this, id, number, arrival,
+                                 query = std::string(query)]() {
+        std::string answer = query;
+        answer += '\t';
+
+        // same as in batch mode, too long to be a word of the dictionary
+        if (query.size() <= maxWordLength) {
+            bool first = true;
+
+            for (const auto& suggestion : correct(query)) {
+                if (!first) {
+                    answer += ',';
+                }
+
+                answer += suggestion.word;
+                first = false;
+            }
+        }
+
+        const auto answered = std::chrono::high_resolution_clock::now();
+        const auto mduration =
+            std::chrono::duration_cast<std::chrono::microseconds>(answered -
+                                                                  arrival);
+
+        statsRecord(StatHistogram::RequestMicroseconds,
+                    static_cast<std::uint64_t>(mduration.count()));
+
+        answer += '\t';
+        answer += std::to_string(mduration.count());
+        answer += '\n';
+
+        {
+            std::lock_guard<std::mutex> lock(completionsMutex);
+            completions.push_back({id, number, std::move(answer)});
+        }
+
+        signalEvent(completionsEvent);
+    });
+}
+
+void EventLoop::collectCompletions() {
+    clearEvent(completionsEvent);
+
+    std::vector<Completion> collected;
+
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex);
+        collected.swap(completions);
+    }
+
+    queriesInFlight -= collected.size();
+    queriesAnswered += collected.size();
+
+    // every connection is written to once, after all its answers are in
+    std::vector<std::uint64_t> touched;
+
+    for (auto& completion : collected) {
+        const auto position = connections.find(completion.connection);
+
+        if (position == connections.end()) {
+            continue;
+        }
+
+        Connection& connection = position->second;
+
+        if (completion.query != connection.nextAnswer) {
+            connection.finished.emplace(completion.query,
+                                        std::move(completion.answer));
+            continue;
+        }
+
+        connection.output += completion.answer;
+        connection.nextAnswer++;
+
+        for (auto next = connection.finished.begin();
+             next != connection.finished.end() &&
+             next->first == connection.nextAnswer;
+             next = connection.finished.erase(next)) {
+            connection.output += next->second;
+            connection.nextAnswer++;
+        }
+
+        touched.push_back(completion.connection);
+    }
+
+    std::ranges::sort(touched);
+    const auto [duplicates, end] = std::ranges::unique(touched);
+    touched.erase(duplicates, end);
+
+    for (const auto id : touched) {
+        const auto position = connections.find(id);
+
+        if (position == connections.end()) {
+            continue;
+        }
+
+        writeTo(id, position->second);
+
+        // room for the queries that were held back
+        const auto remaining = connections.find(id);
+
+        if (remaining != connections.end()) {
+            parseQueries(id, remaining->second);
+        }
+    }
+}
+
+void EventLoop::writeTo(std::uint64_t id, Connection& connection) {
+    while (connection.outputSent < connection.output.size()) {
+        const ssize_t sent =
+            send(connection.socket, connection.output.data() +
+                                        connection.outputSent,
+                 connection.output.size() - connection.outputSent,
+                 MSG_NOSIGNAL);
+
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (sent < 0) {
+            closeConnection(id);
+            return;
+        }
+
+        connection.outputSent += static_cast<std::size_t>(sent);
+    }
+
+    if (connection.outputSent == connection.output.size()) {
+        connection.output.clear();
+        connection.outputSent = 0;
+    } else if (connection.outputSent > maxBufferedOutput / 2) {
+        connection.output.erase(0, connection.outputSent);
+        connection.outputSent = 0;
+    }
+
+    update(id, connection);
+}
+
+void EventLoop::update(std::uint64_t id, Connection& connection) {
+    const bool answered = connection.nextAnswer == connection.nextQuery;
+    const bool written = connection.output.empty();
+
+    // a client that stopped sending is closed once it has all its answers
+    if (connection.readClosed && answered && written &&
+        connection.input.empty()) {
+        closeConnection(id);
+        return;
+    }
+
+    std::uint32_t events = 0;
+
+    if (!connection.readClosed && acceptsQueries(connection)) {
+        events |= EPOLLIN;
+    }
+
+    if (!written) {
+        events |= EPOLLOUT;
+    }
+
+    if (events == connection.events) {
+        return;
+    }
+
+    epoll_event event = {};
+    event.events = events;
+    event.data.u64 = id;
+
+    epoll_ctl(epoll, EPOLL_CTL_MOD, connection.socket, &event);
+    connection.events = events;
+}
+
+void EventLoop::closeConnection(std::uint64_t id) {
+    const auto position = connections.find(id);
+
+    // closing the socket also takes it out of the epoll set
+    close(position->second.socket);
+    connections.erase(position);
+
+    if (listenerPaused && watch(listener, EPOLLIN, listenerTag)) {
+        listenerPaused = false;
+    }
+}
+
+}  // namespace
+
+int runServer(
+    const ServerOptions& options,
+    const std::function<std::vector<Suggestion>(const std::string&)>& correct) {
+    // every connection takes a descriptor, the default soft limit of 1024 is
+    // too low for thousands of them
+    rlimit limit = {};
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 &&
+        limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    EventLoop loop(correct);
+
+    if (loop.listen(options) != 0) {
+        return -1;
+    }
+
+    const int stop = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (stop < 0) {
+        std::cerr << "Event loop could not be created: "
+                  << std::strerror(errno) << "\n";
+        return -1;
+    }
+
+    stopEvent = stop;
+
+    struct sigaction action = {};
+    struct sigaction previousInterrupt = {};
+    struct sigaction previousTerminate = {};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+
+    sigaction(SIGINT, &action, &previousInterrupt);
+    sigaction(SIGTERM, &action, &previousTerminate);
+
+    // clients usually wait for this, even when stdout is not a terminal
+    std::cout << "Send one word per line, stop the server with Ctrl+C" << "\n"
+              << "\n"
+              << std::flush;
+
+    const int result = loop.run(stop);
+
+    sigaction(SIGINT, &previousInterrupt, nullptr);
+    sigaction(SIGTERM, &previousTerminate, nullptr);
+    stopEvent = -1;
+    close(stop);
+
+    return result;
+}
+
+#else
+
+#include <iostream>
+
+int runServer(
+    const ServerOptions&,
+    const std::function<std::vector<Suggestion>(const std::string&)>&) {
+    std::cerr << "The server is only available on Linux" << "\n";
+    return -1;
+}
+
+#endif
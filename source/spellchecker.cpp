@@ -1,12 +1,20 @@
 #include "../include/spellchecker.h"
 
+#include "../include/lev_batch.h"
+#include "../include/stats.h"
+
 #include <algorithm>
+#include <array>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <numeric>
+#include <ranges>
 #include <vector>
 
 #ifdef __GNUC__
 
-int lev(const std::string& a, const std::string& b) {
+int levMatrix(std::string_view a, std::string_view b) {
     const std::size_t a_size = a.size();
     const std::size_t b_size = b.size();
 
@@ -76,7 +84,7 @@ int lev(const std::string& a, const std::string& b) {
 
 // MSVS does not support variable length arrays
 // we have to use _alloca to manually allocate the memory on the stack instead
-int lev(const std::string& a, const std::string& b) {
+int levMatrix(std::string_view a, std::string_view b) {
     const std::size_t a_size = a.size();
     const std::size_t b_size = b.size();
     const std::size_t rows = a_size + 1;
@@ -116,47 +124,579 @@ int lev(const std::string& a, const std::string& b) {
 
 #endif
 
+namespace {
+
+constexpr std::size_t blockBits = 64;
+constexpr std::size_t alphabetSize = 256;
+
+std::size_t charIndex(char c) {
+    return static_cast<std::size_t>(static_cast<unsigned char>(c));
+}
+
+// Myers' algorithm for patterns that fit into a single 64-bit word. Each bit
+// of VP/VN holds a +1/-1 vertical delta of the current column of the matrix,
+// so a whole column is advanced with a handful of word operations
+int levSingleBlock(const std::uint64_t* peq, std::size_t patternSize,
+                   std::string_view text) {
+    const std::uint64_t lastRow = std::uint64_t{1} << (patternSize - 1);
+
+    std::uint64_t vp = ~std::uint64_t{0};
+    std::uint64_t vn = 0;
+    int score = static_cast<int>(patternSize);
+
+    for (const char c : text) {
+        const std::uint64_t eq = peq[charIndex(c)];
+        const std::uint64_t xv = eq | vn;
+        const std::uint64_t xh = (((eq & vp) + vp) ^ vp) | eq;
+
+        std::uint64_t hp = vn | ~(xh | vp);
+        std::uint64_t hn = vp & xh;
+
+        if (hp & lastRow) {
+            score++;
+        } else if (hn & lastRow) {
+            score--;
+        }
+
+        // the first row of the matrix always grows by one to the right
+        hp = (hp << 1) | 1;
+        hn = hn << 1;
+
+        vp = hn | ~(xv | hp);
+        vn = hp & xv;
+    }
+
+    return score;
+}
+
+// Hyyro's block-based extension of Myers' algorithm. Horizontal deltas leaving
+// the bottom row of a block are carried into the top row of the next one
+int levMultiBlock(const std::uint64_t* peq, std::size_t blockCount,
+                  std::size_t patternSize, std::string_view text) {
+    const std::uint64_t highBit = std::uint64_t{1} << (blockBits - 1);
+    const std::uint64_t lastRow = std::uint64_t{1}
+                                  << ((patternSize - 1) % blockBits);
+
+    std::vector<std::uint64_t> vp(blockCount, ~std::uint64_t{0});
+    std::vector<std::uint64_t> vn(blockCount, 0);
+    int score = static_cast<int>(patternSize);
+
+    for (const char c : text) {
+        const std::uint64_t* eqs = peq + charIndex(c) * blockCount;
+
+        std::uint64_t carryP = 1;
+        std::uint64_t carryN = 0;
+
+        for (std::size_t block = 0; block < blockCount; block++) {
+            const std::uint64_t outBit =
+                block + 1 == blockCount ? lastRow : highBit;
+
+            const std::uint64_t xv = eqs[block] | vn[block];
+            const std::uint64_t eq = eqs[block] | carryN;
+            const std::uint64_t xh =
+                (((eq & vp[block]) + vp[block]) ^ vp[block]) | eq;
+
+            std::uint64_t hp = vn[block] | ~(xh | vp[block]);
+            std::uint64_t hn = vp[block] & xh;
+
+            const std::uint64_t outP = (hp & outBit) ? 1 : 0;
+            const std::uint64_t outN = (hn & outBit) ? 1 : 0;
+
+            hp = (hp << 1) | carryP;
+            hn = (hn << 1) | carryN;
+
+            vp[block] = hn | ~(xv | hp);
+            vn[block] = hp & xv;
+
+            carryP = outP;
+            carryN = outN;
+        }
+
+        score += static_cast<int>(carryP) - static_cast<int>(carryN);
+    }
+
+    return score;
+}
+
+std::size_t blocksFor(std::size_t size) {
+    return (size + blockBits - 1) / blockBits;
+}
+
+}  // namespace
+
+LevPattern::LevPattern(std::string_view pattern)
+    : patternSize(pattern.size()),
+      blockCount(blocksFor(pattern.size())),
+      peq(alphabetSize * blocksFor(pattern.size()), 0) {
+    for (std::size_t i = 0; i < patternSize; i++) {
+        peq[charIndex(pattern[i]) * blockCount + i / blockBits] |=
+            std::uint64_t{1} << (i % blockBits);
+    }
+}
+
+int LevPattern::distance(std::string_view word) const {
+    statsAdd(StatCounter::LevCalls);
+    statsAdd(StatCounter::LevCells, patternSize * word.size());
+
+    if (patternSize == 0) {
+        return static_cast<int>(word.size());
+    }
+
+    if (blockCount == 1) {
+        return levSingleBlock(peq.data(), patternSize, word);
+    }
+
+    return levMultiBlock(peq.data(), blockCount, patternSize, word);
+}
+
+int lev(std::string_view a, std::string_view b) {
+    if (a.empty() || b.empty()) {
+        statsAdd(StatCounter::LevCalls);
+        return static_cast<int>(a.size() + b.size());
+    }
+
+    // the cost is (number of pattern blocks) * (text length), so use the
+    // longer word as the pattern whenever it still fits into one block
+    const bool aIsPattern =
+        blocksFor(a.size()) * b.size() <= blocksFor(b.size()) * a.size();
+    const std::string_view pattern = aIsPattern ? a : b;
+    const std::string_view text = aIsPattern ? b : a;
+
+    if (pattern.size() > blockBits) {
+        return LevPattern(pattern).distance(text);
+    }
+
+    statsAdd(StatCounter::LevCalls);
+    statsAdd(StatCounter::LevCells, pattern.size() * text.size());
+
+    // the table is only ever touched at the characters of the pattern, so it
+    // is cheaper to clear those entries afterwards than to rebuild it per call
+    thread_local std::array<std::uint64_t, alphabetSize> peq{};
+
+    for (std::size_t i = 0; i < pattern.size(); i++) {
+        peq[charIndex(pattern[i])] |= std::uint64_t{1} << i;
+    }
+
+    const int distance = levSingleBlock(peq.data(), pattern.size(), text);
+
+    for (const char c : pattern) {
+        peq[charIndex(c)] = 0;
+    }
+
+    return distance;
+}
+
 std::unordered_map<std::string, int> baseListAroundWord(
     const std::string& input, const std::vector<std::string>& words) {
     std::unordered_map<std::string, int> distanceMap;
+    const std::vector<int> distances = levBatch(input, words);
 
-    for (const auto& word : words) {
-        if (word == input) {
+    for (std::size_t i = 0; i < words.size(); i++) {
+        if (words[i] == input) {
             continue;
         }
 
-        distanceMap[word] = lev(input, word);
+        distanceMap[words[i]] = distances[i];
     }
 
     return distanceMap;
 }
 
-std::vector<std::string> findClosestWords(const std::string& input,
-                                          const std::vector<std::string>& words,
-                                          int c) {
-    std::vector<std::string> closest = {words.front()};
-    int closestDistance = lev(input, closest.front());
+namespace {
+
+// Keeps item if its distance is within c of the closest distance seen so far,
+// dropping the items that are no longer within c of the new closest distance
+template <typename Item>
+void keepIfClose(const Item& item, int currentDistance, int c,
+                 std::vector<Item>& closest, std::vector<int>& closestDistances,
+                 int& closestDistance) {
+    if (currentDistance > closestDistance + c) {
+        return;
+    }
+
+    if (currentDistance < closestDistance) {
+        std::size_t kept = 0;
+
+        for (std::size_t i = 0; i < closest.size(); i++) {
+            if (closestDistances[i] <= currentDistance + c) {
+                closest[kept] = std::move(closest[i]);
+                closestDistances[kept] = closestDistances[i];
+                kept++;
+            }
+        }
+
+        closest.resize(kept);
+        closestDistances.resize(kept);
+
+        closest.push_back(item);
+        closestDistances.push_back(currentDistance);
+        closestDistance = currentDistance;
+    } else if (currentDistance == closestDistance ||
+               currentDistance == closestDistance + c) {
+        closest.push_back(item);
+        closestDistances.push_back(currentDistance);
+    }
+}
+
+// Scans words, keeping the ones that are within c of the closest distance seen
+// so far. closestDistance is the running best and doubles as the bound for
+// levBounded, so hopeless candidates are abandoned after a few rows. Returns
+// the number of words scanned
+template <typename Iterator>
+std::size_t scanClosestWords(const std::string& input, Iterator first,
+                             Iterator end, int c,
+                             std::vector<std::string>& closest,
+                             std::vector<int>& closestDistances,
+                             int& closestDistance) {
+    std::size_t scanned = 0;
+
+    for (auto it = first; it != end; ++it) {
+        scanned++;
+
+        const int bound = closestDistance + c;
+        const int currentDistance = levBounded(input, *it, bound);
+
+        if (currentDistance <= bound) {
+            keepIfClose(*it, currentDistance, c, closest, closestDistances,
+                        closestDistance);
+        }
+    }
+
+    return scanned;
+}
+
+// The k best words seen by suggest so far, as a max-heap: the front is the
+// worst of them and is the first to go when a better word comes along
+class SuggestionHeap {
+public:
+    struct Entry {
+        int distance;
+        std::uint32_t word;  // index of the word, which is also its rank
+
+        bool operator<(const Entry& other) const {
+            return distance < other.distance ||
+                   (distance == other.distance && word < other.word);
+        }
+    };
+
+    SuggestionHeap(std::size_t k, int maxDist)
+        : capacity(k), maxDistance(maxDist) {
+        entries.reserve(k);
+    }
 
-    for (auto it = std::next(words.begin()); it != words.end(); ++it) {
-        const int currentDistance = lev(input, *it);
+    // largest distance at which a word can still get in. At exactly this
+    // distance it also needs a lower rank than the front
+    int bound() const {
+        return entries.size() < capacity ? maxDistance
+                                         : entries.front().distance;
+    }
 
-        if (currentDistance < closestDistance) {
-            const auto newEnd = std::remove_if(
-                closest.begin(), closest.end(),
-                [&it, currentDistance, c](const std::string& val) {
-                    return lev(val, *it) > currentDistance + c;
-                });
+    void offer(std::uint32_t word, int distance) {
+        if (distance > maxDistance) {
+            return;
+        }
 
-            closest = std::vector<std::string>(closest.begin(), newEnd);
+        const Entry entry = {distance, word};
 
-            closest.push_back(*it);
-            closestDistance = currentDistance;
-        } else if (currentDistance == closestDistance ||
-                   currentDistance == closestDistance + c) {
-            closest.push_back(*it);
+        if (entries.size() < capacity) {
+            entries.push_back(entry);
+            std::push_heap(entries.begin(), entries.end());
+        } else if (entry < entries.front()) {
+            std::pop_heap(entries.begin(), entries.end());
+            entries.back() = entry;
+            std::push_heap(entries.begin(), entries.end());
         }
     }
 
+    // the entries, best first. Leaves the heap empty
+    std::vector<Entry> take() {
+        std::sort_heap(entries.begin(), entries.end());
+        return std::move(entries);
+    }
+
+private:
+    std::size_t capacity;
+    int maxDistance;
+    std::vector<Entry> entries;
+};
+
+// The words at the smallest distance seen by findClosestCandidates so far.
+// Offered words like a SuggestionHeap, so the scans serve both
+class ClosestWords {
+public:
+    // largest distance at which a word can still get in
+    int bound() const { return closestDistance; }
+
+    void offer(std::uint32_t word, int distance) {
+        if (distance < closestDistance) {
+            words.clear();
+            closestDistance = distance;
+        }
+
+        if (distance == closestDistance) {
+            words.push_back(word);
+        }
+    }
+
+    const std::vector<std::uint32_t>& closest() const { return words; }
+
+private:
+    int closestDistance = std::numeric_limits<int>::max();
+    std::vector<std::uint32_t> words;
+};
+
+// Lower bound on the distance between the input and a member of a cluster
+// from the triangle inequality: the input is medoidDistance away from the
+// medoid and the member memberDistance
+int triangleBound(int medoidDistance, std::uint32_t memberDistance) {
+    return std::abs(medoidDistance - static_cast<int>(memberDistance));
+}
+
+// Offers the words of one group of the batch layout to the collector, a block
+// at a time. Blocks that the length, the character classes or the distances of
+// their words to the medoid put over the bound are skipped
+template <typename Collector>
+std::size_t scanGroupBatched(const std::string& input,
+                             const WordSignature& inputSignature,
+                             const LevBatchWords& batches, std::size_t group,
+                             int medoidDistance,
+                             std::span<const std::uint32_t> medoidDistances,
+                             Collector& collector) {
+    std::size_t scanned = 0;
+    std::array<int, levBatchLanes> distances;
+
+    const LevBatchWords::GroupView& blocks = batches.group(group);
+
+    for (const auto& block : blocks) {
+        scanned += block.itemCount;
+
+        // the checks cover the whole block at once, checking the words one by
+        // one costs more than the kernel
+        statsAdd(StatCounter::FilterChecks, block.itemCount);
+
+        const int bound = collector.bound();
+        const std::size_t lengthDifference =
+            block.length > input.size() ? block.length - input.size()
+                                        : input.size() - block.length;
+
+        if (lengthDifference > static_cast<std::size_t>(bound)) {
+            statsAdd(StatCounter::FilterLengthRejects, block.itemCount);
+            statsAdd(StatCounter::FilterSkippedLev, block.itemCount);
+            continue;
+        }
+
+        if (blockClassBound(inputSignature, block) > bound) {
+            statsAdd(StatCounter::FilterClassRejects, block.itemCount);
+            statsAdd(StatCounter::FilterSkippedLev, block.itemCount);
+            continue;
+        }
+
+        const auto ids = blocks.items(block);
+
+        if (!medoidDistances.empty() &&
+            std::ranges::all_of(ids, [&](std::uint32_t id) {
+                return triangleBound(medoidDistance, medoidDistances[id]) >
+                       bound;
+            })) {
+            statsAdd(StatCounter::FilterTriangleRejects, block.itemCount);
+            statsAdd(StatCounter::FilterSkippedLev, block.itemCount);
+            continue;
+        }
+
+        LevBatchWords::distances(input, blocks, block, distances);
+
+        for (std::size_t lane = 0; lane < ids.size(); lane++) {
+            collector.offer(ids[lane], distances[lane]);
+        }
+    }
+
+    return scanned;
+}
+
+// Offers the words of the index to the collector, the clusters in the order of
+// their medoid's distance to the input, and returns the number of words
+// compared to the input. Whatever the triangle inequality puts over the bound
+// of the collector is skipped: the clusters after the last one that can hold
+// a word within the bound, see suggest, clusters whose radius does not reach
+// the bound and members whose distance to the medoid differs from the input's
+// by more than the bound
+template <typename Collector>
+std::size_t scanClusters(const std::string& input,
+                         const ClusterIndexView& index, Collector& collector) {
+    const bool batched =
+        index.batches != nullptr && input.size() <= levBatchMaxLength;
+    const WordSignature inputSignature = wordSignature(input);
+
+    std::vector<int> medoidDistances(index.clusterCount());
+
+    if (batched) {
+        index.batches->distances(input, 0, medoidDistances);
+    } else {
+        for (std::size_t cluster = 0; cluster < index.clusterCount();
+             cluster++) {
+            medoidDistances[cluster] =
+                lev(input, index.word(index.medoids[cluster]));
+        }
+    }
+
+    std::vector<std::uint32_t> order(index.clusterCount());
+    std::iota(order.begin(), order.end(), std::uint32_t{0});
+    std::ranges::stable_sort(order, {}, [&medoidDistances](std::uint32_t c) {
+        return medoidDistances[c];
+    });
+
+    const int closest = medoidDistances[order.front()];
+    std::size_t examined = index.clusterCount();
+
+    for (const auto cluster : order) {
+        const int medoidDistance = medoidDistances[cluster];
+        const auto bound = static_cast<std::int64_t>(collector.bound());
+
+        if (medoidDistance - closest > 2 * bound) {
+            break;
+        }
+
+        if (!index.radii.empty() &&
+            medoidDistance - static_cast<std::int64_t>(index.radii[cluster]) >
+                bound) {
+            continue;
+        }
+
+        if (batched) {
+            examined += scanGroupBatched(input, inputSignature,
+                                         *index.batches, cluster + 1,
+                                         medoidDistance, index.medoidDistances,
+                                         collector);
+            continue;
+        }
+
+        for (const auto member : index.cluster(cluster)) {
+            examined++;
+
+            const int memberBound = collector.bound();
+
+            if (!index.medoidDistances.empty() &&
+                triangleBound(medoidDistance, index.medoidDistances[member]) >
+                    memberBound) {
+                statsAdd(StatCounter::FilterChecks);
+                statsAdd(StatCounter::FilterTriangleRejects);
+                statsAdd(StatCounter::FilterSkippedLev);
+                continue;
+            }
+
+            if (!index.signatures.empty() &&
+                signaturesExceed(inputSignature, index.signatures[member],
+                                 memberBound)) {
+                statsAdd(StatCounter::FilterSkippedLev);
+                continue;
+            }
+
+            collector.offer(member,
+                            levBounded(input, index.word(member), memberBound));
+        }
+    }
+
+    return examined;
+}
+
+// Counts a query of findClosestCandidates and the words it compared to the
+// query
+void recordQuery(std::size_t candidatesExamined) {
+    statsAdd(StatCounter::Queries);
+    statsAdd(StatCounter::CandidatesExamined, candidatesExamined);
+    statsRecord(StatHistogram::CandidatesPerQuery, candidatesExamined);
+}
+
+}  // namespace
+
+int levBounded(std::string_view a, std::string_view b, int maxDist) {
+    if (maxDist < 0) {
+        statsAdd(StatCounter::LevCalls);
+        return maxDist + 1;
+    }
+
+    const std::size_t a_size = a.size();
+    const std::size_t b_size = b.size();
+
+    // a distance never exceeds the longer word, so a larger bound changes
+    // nothing, and clamping it keeps maxDist + 1 from overflowing
+    if (static_cast<std::size_t>(maxDist) > std::max(a_size, b_size)) {
+        maxDist = static_cast<int>(std::max(a_size, b_size));
+    }
+
+    const int exceeded = maxDist + 1;
+    const std::size_t k = static_cast<std::size_t>(maxDist);
+
+    // the length difference alone needs that many insertions or deletions
+    if ((a_size > b_size ? a_size - b_size : b_size - a_size) > k) {
+        statsAdd(StatCounter::LevCalls);
+        return exceeded;
+    }
+
+    // the band would cover the whole matrix, the bit-parallel kernel is faster
+    if (k >= std::max(a_size, b_size)) {
+        return lev(a, b);
+    }
+
+    statsAdd(StatCounter::LevCalls);
+
+    // Ukkonen's band: only cells with |row - col| <= k can hold a value <= k.
+    // Cells outside of it are treated as "exceeded", which can only make
+    // in-band values larger than k, never hide a value that is <= k
+    thread_local std::vector<int> row;
+    row.assign(b_size + 1, exceeded);
+
+    // k can still reach past the end of the shorter word b
+    for (std::size_t col = 0; col <= std::min(k, b_size); col++) {
+        row[col] = static_cast<int>(col);
+    }
+
+    std::size_t cells = 0;
+
+    for (std::size_t r = 1; r <= a_size; r++) {
+        const std::size_t first = r > k ? r - k : 1;
+        const std::size_t last = std::min(b_size, r + k);
+        cells += last + 1 - first;
+
+        int diag = row[first - 1];
+        int left = first == 1 ? static_cast<int>(r) : exceeded;
+        row[first - 1] = left;
+
+        int rowMin = left;
+
+        for (std::size_t col = first; col <= last; col++) {
+            const int up = row[col];
+            const int adder = a[r - 1] == b[col - 1] ? 0 : 1;
+            const int value = std::min(diag + adder, std::min(up, left) + 1);
+
+            diag = up;
+            row[col] = value;
+            left = value;
+            rowMin = std::min(rowMin, value);
+        }
+
+        // every path to the last cell crosses this row
+        if (rowMin > maxDist) {
+            statsAdd(StatCounter::LevCells, cells);
+            return exceeded;
+        }
+    }
+
+    statsAdd(StatCounter::LevCells, cells);
+
+    return std::min(row[b_size], exceeded);
+}
+
+std::vector<std::string> findClosestWords(const std::string& input,
+                                          const std::vector<std::string>& words,
+                                          int c) {
+    std::vector<std::string> closest = {words.front()};
+    std::vector<int> closestDistances = {lev(input, closest.front())};
+    int closestDistance = closestDistances.front();
+
+    scanClosestWords(input, std::next(words.begin()), words.end(), c, closest,
+                     closestDistances, closestDistance);
+
     return closest;
 }
 
@@ -175,14 +715,64 @@ std::vector<std::string> findClosestCandidates(
     const std::vector<std::string> closestClusterRepresentatives =
         findClosestWords(input, clusterKeys, 0);
 
+    // every representative is a member of its own cluster, so its distance is
+    // a valid starting bound for the scan of the clusters
     std::vector<std::string> closestWords;
+    std::vector<int> closestDistances;
+    int closestDistance = lev(input, closestClusterRepresentatives.front());
+    std::size_t examined = clusterKeys.size();
 
     for (const auto& representative : closestClusterRepresentatives) {
-        const std::vector<std::string> closest =
-            findClosestWords(input, clusterMap.at(representative), 0);
+        const std::vector<std::string>& cluster = clusterMap.at(representative);
+
+        examined += scanClosestWords(input, cluster.begin(), cluster.end(), 0,
+                                     closestWords, closestDistances,
+                                     closestDistance);
+    }
+
+    recordQuery(examined);
+
+    return closestWords;
+}
 
-        closestWords.insert(closestWords.end(), closest.begin(), closest.end());
+std::vector<std::string> findClosestCandidates(const std::string& input,
+                                               const ClusterIndexView& index) {
+    std::vector<std::string> closestWords;
+
+    if (index.clusterCount() == 0) {
+        return closestWords;
     }
 
-    return findClosestWords(input, closestWords, 0);
-}
\ No newline at end of file
+    ClosestWords closest;
+
+    recordQuery(scanClusters(input, index, closest));
+
+    closestWords.reserve(closest.closest().size());
+
+    for (const auto member : closest.closest()) {
+        closestWords.emplace_back(index.word(member));
+    }
+
+    return closestWords;
+}
+
+std::vector<Suggestion> suggest(const std::string& input,
+                                const ClusterIndexView& index, std::size_t k,
+                                int maxDist) {
+    std::vector<Suggestion> suggestions;
+
+    if (index.clusterCount() == 0 || k == 0 || maxDist < 0) {
+        return suggestions;
+    }
+
+    SuggestionHeap heap(k, maxDist);
+
+    recordQuery(scanClusters(input, index, heap));
+
+    for (const auto& entry : heap.take()) {
+        suggestions.push_back(
+            {std::string(index.word(entry.word)), entry.distance, entry.word});
+    }
+
+    return suggestions;
+}
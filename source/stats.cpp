@@ -0,0 +1,250 @@
+#include "../include/stats.h"
+
+#include <iomanip>
+
+std::array<StatsShard, statsShardCount> statsShards;
+
+namespace {
+
+std::atomic<std::size_t> assignedShards = 0;
+
+constexpr std::array<const char*, statCounterCount> counterNames = {
+    "lev_calls",
+    "lev_cells",
+    "clustering_rounds",
+    "clustering_refinements",
+    "clustering_reassignments",
+    "clustering_swaps",
+    "central_medoid_ns",
+    "furthest_element_ns",
+    "split_ns",
+    "refinement_ns",
+    "queries",
+    "candidates_examined",
+    "filter_checks",
+    "filter_length_rejects",
+    "filter_class_rejects",
+    "filter_bigram_rejects",
+    "filter_bag_rejects",
+    "filter_triangle_rejects",
+    "filter_skipped_lev",
+    "cache_hits",
+    "cache_misses",
+    "cache_evictions",
+    "cache_rejections",
+};
+
+constexpr std::array<const char*, statHistogramCount> histogramNames = {
+    "query_us",
+    "candidates_per_query",
+    "reassignments_per_refinement",
+    "request_us",
+};
+
+// smallest value of a bucket, see StatHistogram
+std::uint64_t bucketStart(std::size_t bucket) {
+    return bucket == 0 ? 0 : std::uint64_t{1} << (bucket - 1);
+}
+
+// upper end of the bucket holding the value at the given fraction of all values
+std::uint64_t percentile(const StatsSnapshot::Histogram& histogram,
+                         double fraction) {
+    const auto rank = static_cast<std::uint64_t>(
+        fraction * static_cast<double>(histogram.count));
+    std::uint64_t seen = 0;
+
+    for (std::size_t bucket = 0; bucket < statHistogramBuckets; bucket++) {
+        seen += histogram.buckets[bucket];
+
+        if (seen > rank) {
+            return std::min(bucketStart(bucket + 1), histogram.max);
+        }
+    }
+
+    return histogram.max;
+}
+
+double mean(const StatsSnapshot::Histogram& histogram) {
+    return histogram.count == 0 ? 0.0
+                                : static_cast<double>(histogram.sum) /
+                                      static_cast<double>(histogram.count);
+}
+
+std::uint64_t counterValue(const StatsSnapshot& snapshot, StatCounter counter) {
+    return snapshot.counters[static_cast<std::size_t>(counter)];
+}
+
+// share of the checks of the filter cascade that each filter rejected
+void printFilterHitRates(std::ostream& output, const StatsSnapshot& snapshot) {
+    const std::uint64_t checks =
+        counterValue(snapshot, StatCounter::FilterChecks);
+
+    if (checks == 0) {
+        return;
+    }
+
+    const auto percent = [&snapshot, checks](StatCounter counter) {
+        return 100.0 * static_cast<double>(counterValue(snapshot, counter)) /
+               static_cast<double>(checks);
+    };
+
+    output << "\nfilter hit rate: " << std::fixed << std::setprecision(1)
+           << percent(StatCounter::FilterLengthRejects) << "% length, "
+           << percent(StatCounter::FilterClassRejects) << "% classes, "
+           << percent(StatCounter::FilterBigramRejects) << "% bigrams, "
+           << percent(StatCounter::FilterBagRejects) << "% bag, "
+           << percent(StatCounter::FilterTriangleRejects) << "% triangle"
+           << std::defaultfloat << "\n";
+}
+
+// share of the lookups of the query cache that it answered
+void printCacheHitRate(std::ostream& output, const StatsSnapshot& snapshot) {
+    const std::uint64_t hits = counterValue(snapshot, StatCounter::CacheHits);
+    const std::uint64_t lookups =
+        hits + counterValue(snapshot, StatCounter::CacheMisses);
+
+    if (lookups == 0) {
+        return;
+    }
+
+    output << "\ncache hit rate: " << std::fixed << std::setprecision(1)
+           << 100.0 * static_cast<double>(hits) / static_cast<double>(lookups)
+           << "%" << std::defaultfloat << "\n";
+}
+
+}  // namespace
+
+std::size_t nextStatsShard() {
+    return assignedShards.fetch_add(1, std::memory_order_relaxed) %
+           statsShardCount;
+}
+
+StatsSnapshot statsSnapshot() {
+    StatsSnapshot snapshot;
+
+    for (const auto& shard : statsShards) {
+        for (std::size_t i = 0; i < statCounterCount; i++) {
+            snapshot.counters[i] +=
+                shard.counters[i].load(std::memory_order_relaxed);
+        }
+
+        for (std::size_t i = 0; i < statHistogramCount; i++) {
+            const StatsHistogram& source = shard.histograms[i];
+            StatsSnapshot::Histogram& target = snapshot.histograms[i];
+
+            target.count += source.count.load(std::memory_order_relaxed);
+            target.sum += source.sum.load(std::memory_order_relaxed);
+            target.max = std::max(target.max,
+                                  source.max.load(std::memory_order_relaxed));
+
+            for (std::size_t bucket = 0; bucket < statHistogramBuckets;
+                 bucket++) {
+                target.buckets[bucket] +=
+                    source.buckets[bucket].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    return snapshot;
+}
+
+void resetStats() {
+    for (auto& shard : statsShards) {
+        for (auto& counter : shard.counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+
+        for (auto& histogram : shard.histograms) {
+            histogram.count.store(0, std::memory_order_relaxed);
+            histogram.sum.store(0, std::memory_order_relaxed);
+            histogram.max.store(0, std::memory_order_relaxed);
+
+            for (auto& bucket : histogram.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+const char* statCounterName(StatCounter counter) {
+    return counterNames[static_cast<std::size_t>(counter)];
+}
+
+const char* statHistogramName(StatHistogram histogram) {
+    return histogramNames[static_cast<std::size_t>(histogram)];
+}
+
+void printStats(std::ostream& output, const StatsSnapshot& snapshot) {
+    if (!statsEnabled) {
+        output << "Statistics are disabled in this build" << "\n\n";
+        return;
+    }
+
+    for (std::size_t i = 0; i < statCounterCount; i++) {
+        output << std::left << std::setw(30) << counterNames[i] << std::right
+               << snapshot.counters[i] << "\n";
+    }
+
+    printFilterHitRates(output, snapshot);
+    printCacheHitRate(output, snapshot);
+
+    for (std::size_t i = 0; i < statHistogramCount; i++) {
+        const StatsSnapshot::Histogram& histogram = snapshot.histograms[i];
+
+        output << "\n"
+               << histogramNames[i] << ": count " << histogram.count
+               << ", mean " << std::fixed << std::setprecision(1)
+               << mean(histogram) << std::defaultfloat << ", p50 <= "
+               << percentile(histogram, 0.5) << ", p99 <= "
+               << percentile(histogram, 0.99) << ", max " << histogram.max
+               << "\n";
+
+        for (std::size_t bucket = 0; bucket < statHistogramBuckets; bucket++) {
+            if (histogram.buckets[bucket] == 0) {
+                continue;
+            }
+
+            output << "  [" << bucketStart(bucket) << ", "
+                   << bucketStart(bucket + 1) << "): "
+                   << histogram.buckets[bucket] << "\n";
+        }
+    }
+
+    output << "\n";
+}
+
+void writeStatsJson(std::ostream& output, const StatsSnapshot& snapshot) {
+    output << "{\n" << "  \"enabled\": " << (statsEnabled ? "true" : "false")
+           << ",\n" << "  \"counters\": {";
+
+    for (std::size_t i = 0; i < statCounterCount; i++) {
+        output << (i == 0 ? "\n" : ",\n") << "    \"" << counterNames[i]
+               << "\": " << snapshot.counters[i];
+    }
+
+    output << "\n  },\n" << "  \"histograms\": {";
+
+    for (std::size_t i = 0; i < statHistogramCount; i++) {
+        const StatsSnapshot::Histogram& histogram = snapshot.histograms[i];
+
+        output << (i == 0 ? "\n" : ",\n") << "    \"" << histogramNames[i]
+               << "\": {\"count\": " << histogram.count
+               << ", \"sum\": " << histogram.sum
+               << ", \"max\": " << histogram.max << ", \"buckets\": [";
+
+        // trailing empty buckets are left out
+        std::size_t used = statHistogramBuckets;
+
+        while (used > 0 && histogram.buckets[used - 1] == 0) {
+            used--;
+        }
+
+        for (std::size_t bucket = 0; bucket < used; bucket++) {
+            output << (bucket == 0 ? "" : ", ") << histogram.buckets[bucket];
+        }
+
+        output << "]}";
+    }
+
+    output << "\n  }\n}\n";
+}
@@ -0,0 +1,181 @@
+#include "../include/symspell.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace {
+
+std::uint64_t hashVariant(std::string_view variant) {
+    // FNV-1a
+    std::uint64_t hash = 0xCBF29CE484222325ull;
+
+    for (const char c : variant) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001B3ull;
+    }
+
+    return hash;
+}
+
+// Calls emit with the hash of every string that can be made from word with up
+// to depth deletions, the word itself included. Positions are deleted in
+// increasing order so each combination of positions is generated once
+template <typename Emit>
+void forEachDeleteVariant(std::string_view word, int depth,
+                          std::size_t firstPosition, const Emit& emit) {
+    if (depth == 0) {
+        return;
+    }
+
+    std::string variant;
+
+    for (std::size_t i = firstPosition; i < word.size(); i++) {
+        variant.assign(word);
+        variant.erase(i, 1);
+
+        emit(hashVariant(variant));
+        forEachDeleteVariant(variant, depth - 1, i, emit);
+    }
+}
+
+template <typename Emit>
+void forEachVariant(std::string_view word, int maxDistance,
+                    const Emit& emit) {
+    emit(hashVariant(word));
+    forEachDeleteVariant(word, maxDistance, 0, emit);
+}
+
+}  // namespace
+
+SymSpellIndex::SymSpellIndex(const Dictionary& wordList,
+                             int maxEditDistance)
+    : maxDistance(std::max(maxEditDistance, 0)), words(wordList) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> entries;
+
+    for (std::uint32_t index = 0; index < words.size(); index++) {
+        forEachVariant(words[index], maxDistance,
+                       [&entries, index](std::uint64_t hash) {
+                           entries.emplace_back(hash, index);
+                       });
+    }
+
+    // the same variant can come from one word in several ways
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    postings.reserve(entries.size());
+
+    for (const auto& [hash, index] : entries) {
+        if (variantHashes.empty() || variantHashes.back() != hash) {
+            variantHashes.push_back(hash);
+            postingStarts.push_back(static_cast<std::uint32_t>(postings.size()));
+        }
+
+        postings.push_back(index);
+    }
+
+    postingStarts.push_back(static_cast<std::uint32_t>(postings.size()));
+
+    // keep the load factor of the table at or below one half
+    std::size_t tableSize = 16;
+
+    while (tableSize < variantHashes.size() * 2) {
+        tableSize *= 2;
+    }
+
+    table.assign(tableSize, emptySlot);
+    tableMask = tableSize - 1;
+
+    for (std::size_t i = 0; i < variantHashes.size(); i++) {
+        std::uint64_t slot = variantHashes[i] & tableMask;
+
+        while (table[slot] != emptySlot) {
+            slot = (slot + 1) & tableMask;
+        }
+
+        table[slot] = static_cast<std::uint32_t>(i);
+    }
+
+    variantHashes.shrink_to_fit();
+    postingStarts.shrink_to_fit();
+
+    const auto stop = std::chrono::high_resolution_clock::now();
+    buildDuration =
+        std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
+}
+
+std::uint32_t SymSpellIndex::findVariant(std::uint64_t hash) const {
+    std::uint64_t slot = hash & tableMask;
+
+    while (table[slot] != emptySlot) {
+        if (variantHashes[table[slot]] == hash) {
+            return table[slot];
+        }
+
+        slot = (slot + 1) & tableMask;
+    }
+
+    return emptySlot;
+}
+
+std::vector<Suggestion> SymSpellIndex::lookup(const std::string& query,
+                                              int maxDist) const {
+    std::vector<Suggestion> results;
+    maxDist = std::min(maxDist, maxDistance);
+
+    if (maxDist < 0 || words.empty()) {
+        return results;
+    }
+
+    std::vector<std::uint32_t> candidates;
+
+    forEachVariant(query, maxDist, [this, &candidates](std::uint64_t hash) {
+        const std::uint32_t variant = findVariant(hash);
+
+        if (variant == emptySlot) {
+            return;
+        }
+
+        candidates.insert(candidates.end(),
+                          postings.begin() + postingStarts[variant],
+                          postings.begin() + postingStarts[variant + 1]);
+    });
+
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+
+    // sharing a variant only means the word may be close enough, and hash
+    // collisions add a few false candidates on top
+    for (const auto candidate : candidates) {
+        const int distance = levBounded(query, words[candidate], maxDist);
+
+        if (distance <= maxDist) {
+            results.push_back(
+                {std::string(words[candidate]), distance, candidate});
+        }
+    }
+
+    std::sort(results.begin(), results.end(),
+              [](const Suggestion& a, const Suggestion& b) {
+                  return a.distance < b.distance ||
+                         (a.distance == b.distance && a.rank < b.rank);
+              });
+
+    return results;
+}
+
+std::size_t SymSpellIndex::memoryUsage() const {
+    std::size_t bytes = sizeof(*this);
+
+    bytes += words.memoryUsage() - sizeof(words);
+    bytes += variantHashes.capacity() * sizeof(std::uint64_t);
+    bytes += postingStarts.capacity() * sizeof(std::uint32_t);
+    bytes += postings.capacity() * sizeof(std::uint32_t);
+    bytes += table.capacity() * sizeof(std::uint32_t);
+
+    return bytes;
+}
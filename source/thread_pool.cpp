@@ -0,0 +1,127 @@
+#include "../include/thread_pool.h"
+
+namespace {
+
+// lets submit() find the queue of the worker it is called from
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local std::size_t currentWorker = 0;
+
+std::atomic<std::size_t> sharedThreadCount = 0;
+
+}  // namespace
+
+ThreadPool::ThreadPool(std::size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max<std::size_t>(std::thread::hardware_concurrency(),
+                                            1);
+    }
+
+    // the thread calling parallelFor works too, so it gets no worker
+    const std::size_t workerCount = threadCount - 1;
+
+    for (std::size_t i = 0; i < workerCount; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (std::size_t i = 0; i < workerCount; i++) {
+        workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+
+    wake.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    if (workers.empty()) {
+        task();
+        return;
+    }
+
+    const std::size_t index =
+        currentPool == this ? currentWorker
+                            : nextQueue.fetch_add(1) % queues.size();
+
+    // counted before it is queued, so a worker can never take it while the
+    // count still says there is nothing to do
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queuedTasks++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+
+    wake.notify_one();
+}
+
+bool ThreadPool::popTask(std::size_t index, std::function<void()>& task) {
+    // newest task of our own first, it is the most likely to be in cache...
+    {
+        Queue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queuedTasks--;
+            return true;
+        }
+    }
+
+    // ...otherwise steal the oldest task of another worker
+    for (std::size_t offset = 1; offset < queues.size(); offset++) {
+        Queue& other = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(other.mutex);
+
+        if (!other.tasks.empty()) {
+            task = std::move(other.tasks.front());
+            other.tasks.pop_front();
+            queuedTasks--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::workerLoop(std::size_t index) {
+    currentPool = this;
+    currentWorker = index;
+
+    while (true) {
+        std::function<void()> task;
+
+        if (popTask(index, task)) {
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return stopping || queuedTasks > 0; });
+
+        if (stopping && queuedTasks == 0) {
+            return;
+        }
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(sharedThreadCount.load());
+    return pool;
+}
+
+void ThreadPool::setSharedThreadCount(std::size_t threadCount) {
+    sharedThreadCount = threadCount;
+}
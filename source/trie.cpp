@@ -0,0 +1,167 @@
+#include "../include/trie.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+
+namespace {
+
+bool isCloser(const Suggestion& a, const Suggestion& b) {
+    return a.distance < b.distance ||
+           (a.distance == b.distance && a.rank < b.rank);
+}
+
+}  // namespace
+
+Trie::Trie(const Dictionary& wordList) : words(wordList) {
+    // words sharing a prefix are next to each other once sorted, so every
+    // node covers one range of them
+    std::vector<std::uint32_t> sorted(words.size());
+    std::iota(sorted.begin(), sorted.end(), std::uint32_t{0});
+    std::sort(sorted.begin(), sorted.end(),
+              [this](std::uint32_t a, std::uint32_t b) {
+                  return words[a] < words[b];
+              });
+
+    // range of sorted words below every node queued so far, and its depth
+    struct Range {
+        std::size_t first;
+        std::size_t last;
+        std::size_t depth;
+    };
+
+    std::vector<Range> ranges = {{0, sorted.size(), 0}};
+    nodes.push_back({0, 0, Dictionary::npos});
+    labels.push_back('\0');
+
+    for (std::size_t node = 0; node < nodes.size(); node++) {
+        auto [first, last, nodeDepth] = ranges[node];
+        depth = std::max(depth, nodeDepth);
+
+        // a word ending here sorts before the longer words it is a prefix of
+        if (first < last && words[sorted[first]].size() == nodeDepth) {
+            nodes[node].rank = sorted[first];
+            first++;
+        }
+
+        nodes[node].firstChild = static_cast<std::uint32_t>(nodes.size());
+
+        while (first < last) {
+            const char label = words[sorted[first]][nodeDepth];
+            std::size_t end = first + 1;
+
+            while (end < last && words[sorted[end]][nodeDepth] == label) {
+                end++;
+            }
+
+            nodes.push_back({0, 0, Dictionary::npos});
+            labels.push_back(label);
+            ranges.push_back({first, end, nodeDepth + 1});
+            first = end;
+        }
+
+        nodes[node].childCount =
+            static_cast<std::uint32_t>(nodes.size()) - nodes[node].firstChild;
+    }
+
+    nodes.shrink_to_fit();
+    labels.shrink_to_fit();
+}
+
+std::vector<Suggestion> Trie::nearest(const std::string& query, std::size_t k,
+                                      int maxDist) const {
+    // max-heap on distance, the front is the worst of the k best so far
+    std::vector<Suggestion> best;
+
+    if (words.empty() || k == 0 || maxDist < 0) {
+        return best;
+    }
+
+    const std::size_t width = query.size() + 1;
+
+    // row d is the distance of the query prefixes to the prefix of length d
+    // leading to the node being visited. The walk is depth-first, so the row
+    // above a node is always the one of its parent
+    std::vector<int> rows((depth + 1) * width);
+    std::iota(rows.begin(), rows.begin() + static_cast<std::ptrdiff_t>(width),
+              0);
+
+    const auto offer = [this, k, &best](std::uint32_t rank, int distance) {
+        const Suggestion candidate = {std::string(words[rank]), distance,
+                                      rank};
+
+        if (best.size() < k) {
+            best.push_back(candidate);
+            std::push_heap(best.begin(), best.end(), isCloser);
+        } else if (isCloser(candidate, best.front())) {
+            std::pop_heap(best.begin(), best.end(), isCloser);
+            best.back() = candidate;
+            std::push_heap(best.begin(), best.end(), isCloser);
+        }
+    };
+
+    int radius = maxDist;
+
+    if (nodes.front().rank != Dictionary::npos &&
+        static_cast<int>(query.size()) <= radius) {
+        offer(nodes.front().rank, static_cast<int>(query.size()));
+    }
+
+    struct Pending {
+        std::uint32_t node;
+        std::uint32_t depth;
+    };
+
+    std::vector<Pending> pending;
+
+    for (std::uint32_t i = 0; i < nodes.front().childCount; i++) {
+        pending.push_back({nodes.front().firstChild + i, 1});
+    }
+
+    while (!pending.empty()) {
+        const Pending current = pending.back();
+        pending.pop_back();
+
+        const int* above = rows.data() + (current.depth - 1) * width;
+        int* row = rows.data() + current.depth * width;
+        const char label = labels[current.node];
+
+        row[0] = static_cast<int>(current.depth);
+        int rowMinimum = row[0];
+
+        for (std::size_t j = 1; j < width; j++) {
+            row[j] = std::min({above[j] + 1, row[j - 1] + 1,
+                               above[j - 1] + (query[j - 1] != label)});
+            rowMinimum = std::min(rowMinimum, row[j]);
+        }
+
+        const Node& node = nodes[current.node];
+
+        if (node.rank != Dictionary::npos && row[width - 1] <= radius) {
+            offer(node.rank, row[width - 1]);
+
+            if (best.size() == k) {
+                radius = std::min(radius, best.front().distance);
+            }
+        }
+
+        // every word below the node is at least rowMinimum away. A word at the
+        // radius may still win on its rank, so only larger minimums are cut
+        if (rowMinimum > radius) {
+            continue;
+        }
+
+        for (std::uint32_t i = 0; i < node.childCount; i++) {
+            pending.push_back({node.firstChild + i, current.depth + 1});
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), isCloser);
+
+    return best;
+}
+
+std::size_t Trie::memoryUsage() const {
+    return sizeof(*this) - sizeof(words) + words.memoryUsage() +
+           nodes.capacity() * sizeof(Node) + labels.capacity() * sizeof(char);
+}
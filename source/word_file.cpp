@@ -0,0 +1,217 @@
+#include "../include/word_file.h"
+
+#include "../include/mapped_file.h"
+#include "../include/thread_pool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+// bytes of the file handled by one task, extended to the next line break
+constexpr std::size_t chunkBytes = std::size_t{1} << 20;
+
+// number of messages printed before further ones are suppressed
+constexpr int longWordMessageLimit = 10;
+constexpr int duplicateMessageLimit = 15;
+
+// A line of a chunk. The hash and signature are only calculated for lines
+// that are short enough to be added
+struct Line {
+    std::size_t start;
+    std::size_t size;
+    std::uint64_t hash;
+    WordSignature signature;
+};
+
+// Lines of the file that no other chunk touches, lowerCase is a lowercased
+// copy of all of them with the line breaks still in place
+struct Chunk {
+    std::string_view contents;
+    std::string lowerCase;
+    std::vector<Line> lines;
+};
+
+std::vector<Chunk> splitIntoChunks(std::string_view contents) {
+    std::vector<Chunk> chunks;
+    std::size_t start = 0;
+
+    while (start < contents.size()) {
+        std::size_t end = std::min(start + chunkBytes, contents.size());
+        const std::size_t lineBreak = contents.find('\n', end - 1);
+
+        end = lineBreak == std::string_view::npos ? contents.size()
+                                                  : lineBreak + 1;
+
+        chunks.push_back({contents.substr(start, end - start), {}, {}});
+        start = end;
+    }
+
+    return chunks;
+}
+
+// Splits a chunk into lines the way getline does: a final line without a line
+// break still counts, the empty rest after a final line break does not
+void prepareChunk(Chunk& chunk) {
+    chunk.lowerCase.resize(chunk.contents.size());
+    std::transform(chunk.contents.begin(), chunk.contents.end(),
+                   chunk.lowerCase.begin(), [](unsigned char c) {
+                       return static_cast<char>(std::tolower(c));
+                   });
+
+    const std::string_view lowerCase = chunk.lowerCase;
+    std::size_t start = 0;
+
+    while (start < lowerCase.size()) {
+        const std::size_t lineBreak = lowerCase.find('\n', start);
+        const std::size_t end =
+            lineBreak == std::string_view::npos ? lowerCase.size() : lineBreak;
+
+        Line line = {start, end - start, 0, {}};
+
+        if (line.size <= maxWordLength) {
+            const std::string_view word = lowerCase.substr(start, line.size);
+
+            line.hash = Dictionary::hash(word);
+            line.signature = wordSignature(word);
+        }
+
+        chunk.lines.push_back(line);
+        start = end + 1;
+    }
+}
+
+}  // namespace
+
+int readWordsFromFile(Dictionary& words, const std::string& filePath) {
+    std::cout << "Reading file at " << filePath << " ... \n\n" << std::flush;
+
+    MappedFile file;
+
+    if (file.open(filePath) != 0) {
+        std::cerr << "File at " << filePath << " could not be opened"
+                  << "\n";
+        return -1;
+    }
+
+    std::vector<Chunk> chunks = splitIntoChunks(file.contents());
+
+    parallelFor(chunks.size(), 1,
+                [&chunks](std::size_t chunkBegin, std::size_t chunkEnd) {
+                    for (std::size_t i = chunkBegin; i < chunkEnd; i++) {
+                        prepareChunk(chunks[i]);
+                    }
+                });
+
+    std::size_t lineCount = 0;
+
+    for (const auto& chunk : chunks) {
+        lineCount += chunk.lines.size();
+    }
+
+    words.reserve(words.size() + lineCount,
+                  words.bytes().size() + file.contents().size());
+
+    std::ofstream duplicateLog;
+    std::ofstream longLog;
+
+    int longCounter = 0;
+    bool longLimitExceeded = false;
+
+    int repeatedCounter = 0;
+    bool repeatedLimitExceeded = false;
+
+    // the words are added in file order, so the first of several duplicates
+    // is kept and the messages come out as if the file was read line by line
+    for (const auto& chunk : chunks) {
+        for (const auto& entry : chunk.lines) {
+            const std::string_view line =
+                chunk.contents.substr(entry.start, entry.size);
+
+            if (entry.size > maxWordLength) {
+                longCounter++;
+
+                if (!longLimitExceeded) {
+                    if (longCounter <= longWordMessageLimit) {
+                        if (!longLog.is_open()) {
+                            longLog.open("too_long_words.txt");
+
+                            std::cout << "Logging too-long words to "
+                                         "'too_long_words.txt'.\n";
+                        }
+                        longLog << line << "\n";
+
+                        std::cout << "Word exceeds 50 characters: \"" << line
+                                  << "\".\n"
+                                     "Words longer than 50 characters are not "
+                                     "allowed. Skipping.\n\n";
+                    } else {
+                        longLimitExceeded = true;
+                        std::cout << "More than 10 words exceed 50 "
+                                     "characters. Further messages will be "
+                                     "suppressed.\n\n";
+                    }
+                }
+                continue;
+            }
+
+            const std::string_view lowerCaseLine =
+                std::string_view(chunk.lowerCase).substr(entry.start,
+                                                         entry.size);
+
+            if (!words.insert(lowerCaseLine, entry.hash, entry.signature)
+                     .second) {
+                repeatedCounter++;
+
+                if (!duplicateLog.is_open()) {
+                    duplicateLog.open("duplicates.txt");
+                    std::cout
+                        << "Logging duplicate words to 'duplicates.txt'.\n";
+                }
+
+                duplicateLog << line << "\n";
+
+                if (!repeatedLimitExceeded) {
+                    if (repeatedCounter <= duplicateMessageLimit) {
+                        std::cout << "Duplicate word found: \"" << line
+                                  << "\". Skipping.\n\n";
+                    } else {
+                        repeatedLimitExceeded = true;
+                        std::cout << "More than 15 duplicate words found. "
+                                     "Further messages will be "
+                                     "suppressed.\n\n";
+                    }
+                }
+                continue;
+            }
+        }
+    }
+
+    if (duplicateLog.is_open()) {
+        duplicateLog.close();
+        std::cout << "Duplicates logged to 'duplicates.txt'\n";
+    }
+
+    if (longLog.is_open()) {
+        longLog.close();
+        std::cout << "Long words logged to 'too_long_words.txt'\n";
+    }
+
+    file.close();
+
+    if (words.empty()) {
+        std::cerr << "\n"
+                  << "File at " << filePath << " was empty" << "\n";
+        return -1;
+    }
+
+    std::cout << "Skipped " << longCounter
+              << " word(s) longer than 50 characters\n";
+    std::cout << "Skipped " << repeatedCounter << " duplicate word(s)\n\n";
+
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "../include/word_signature.h"
+
+#include <limits>
+
+namespace {
+
+std::size_t signatureClass(char c) {
+    const unsigned folded = static_cast<unsigned char>(c) | 0x20u;
+
+    return folded >= 'a' && folded <= 'z' ? folded - 'a'
+                                          : signatureClasses - 1;
+}
+
+std::uint16_t saturate(std::size_t value) {
+    return static_cast<std::uint16_t>(std::min<std::size_t>(
+        value, std::numeric_limits<std::uint16_t>::max()));
+}
+
+}  // namespace
+
+WordSignature wordSignature(std::string_view word) {
+    WordSignature signature = {};
+    unsigned countTotal = 0;
+
+    // the counts are kept packed, a nibble that reached 15 stays there
+    for (const char c : word) {
+        const std::size_t characterClass = signatureClass(c);
+        std::uint64_t& counts = signature.counts[characterClass / 16];
+        const std::size_t shift = 4 * (characterClass % 16);
+        const bool saturated = ((counts >> shift) & 0x0F) == 0x0F;
+
+        counts += std::uint64_t{!saturated} << shift;
+        countTotal += !saturated;
+        signature.classes |= std::uint32_t{1} << characterClass;
+    }
+
+    for (std::size_t i = 1; i < word.size(); i++) {
+        const std::uint64_t bigram =
+            (std::uint64_t{static_cast<unsigned char>(word[i - 1])} << 8) |
+            static_cast<unsigned char>(word[i]);
+
+        // Fibonacci hashing, the top 6 bits pick one of the 64
+        signature.bigrams |= std::uint64_t{1}
+                             << ((bigram * 0x9E3779B97F4A7C15ull) >> 58);
+    }
+
+    signature.length = saturate(word.size());
+    signature.countTotal = static_cast<std::uint16_t>(countTotal);
+
+    return signature;
+}
@@ -0,0 +1,110 @@
+#include <lev_batch.h>
+#include <spellchecker.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compares every batch kernel the CPU supports against levMatrix on seeded
+// random queries and groups of words. Exits with 1 on the first mismatch
+
+namespace {
+
+constexpr std::array<LevBatchKernel, 3> kernels = {
+    LevBatchKernel::Scalar, LevBatchKernel::Sse2, LevBatchKernel::Avx2};
+
+constexpr std::size_t groupCount = 40;
+constexpr std::size_t queriesPerGroup = 25;
+
+// longer than levBatchMaxLength, so the fallback to lev is covered too
+constexpr std::size_t maxLength = levBatchMaxLength + 8;
+
+std::string randomWord(std::mt19937_64& random, std::size_t length) {
+    std::uniform_int_distribution<int> character('a', 'e');
+    std::string word(length, '\0');
+
+    for (auto& c : word) {
+        c = static_cast<char>(character(random));
+    }
+
+    return word;
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937_64 random(42);
+    std::size_t compared = 0;
+    int failures = 0;
+
+    for (const auto kernel : kernels) {
+        if (!isLevBatchKernelSupported(kernel)) {
+            std::cout << levBatchKernelName(kernel)
+                      << " is not supported, skipped\n";
+            continue;
+        }
+
+        for (std::size_t g = 0; g < groupCount; g++) {
+            // few lengths per group give full blocks, many lengths give blocks
+            // with only some of their lanes used
+            const std::size_t lengthCount = 1 + random() % 12;
+            const std::size_t firstLength = random() % (maxLength - 11);
+            const std::size_t wordCount = 1 + random() % 150;
+
+            std::vector<std::string> words;
+            std::vector<std::uint32_t> ids;
+
+            for (std::size_t i = 0; i < wordCount; i++) {
+                words.push_back(
+                    randomWord(random, firstLength + random() % lengthCount));
+                ids.push_back(static_cast<std::uint32_t>(i));
+            }
+
+            const std::vector<std::string_view> views(words.begin(),
+                                                      words.end());
+            LevBatchWords batches;
+            batches.addGroup(ids, views);
+
+            for (std::size_t q = 0; q < queriesPerGroup; q++) {
+                const std::string query =
+                    randomWord(random, random() % (maxLength + 1));
+                std::vector<int> results(wordCount, -1);
+
+                batches.distances(query, 0, results, kernel);
+
+                for (std::size_t i = 0; i < wordCount; i++) {
+                    compared++;
+
+                    const int expected = levMatrix(query, words[i]);
+
+                    if (results[i] == expected) {
+                        continue;
+                    }
+
+                    failures++;
+
+                    if (failures <= 10) {
+                        std::cerr << levBatchKernelName(kernel) << " returned "
+                                  << results[i] << " instead of " << expected
+                                  << " for a query of length " << query.size()
+                                  << " and a word of length "
+                                  << words[i].size() << "\n";
+                    }
+                }
+            }
+        }
+    }
+
+    if (failures != 0) {
+        std::cerr << failures << " mismatches against levMatrix\n";
+        return 1;
+    }
+
+    std::cout << compared << " batch distances match levMatrix\n";
+    return 0;
+}
@@ -0,0 +1,148 @@
+#include <spellchecker.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <string>
+
+// Compares lev, levBounded and LevPattern against the full DP matrix of
+// levMatrix on seeded random pairs. Exits with 1 on the first mismatch
+
+namespace {
+
+// lengths around the 64-bit block boundaries of the bit-parallel kernel and
+// words spanning more than two blocks
+constexpr std::array<std::size_t, 12> edgeLengths = {
+    0, 1, 2, 31, 63, 64, 65, 127, 128, 129, 130, 200};
+
+constexpr std::size_t randomPairs = 20000;
+
+// a small alphabet makes long matching runs likely, the full one reaches the
+// characters above 127
+std::string randomWord(std::mt19937_64& random, std::size_t length,
+                       bool smallAlphabet) {
+    std::uniform_int_distribution<int> character =
+        smallAlphabet ? std::uniform_int_distribution<int>('a', 'd')
+                      : std::uniform_int_distribution<int>(1, 255);
+    std::string word(length, '\0');
+
+    for (auto& c : word) {
+        c = static_cast<char>(character(random));
+    }
+
+    return word;
+}
+
+// turns a word into a close variant of it, so the distances are mostly small
+std::string mutate(std::mt19937_64& random, std::string word,
+                   std::size_t edits) {
+    std::uniform_int_distribution<int> character('a', 'd');
+
+    for (std::size_t i = 0; i < edits; i++) {
+        const std::size_t position =
+            word.empty() ? 0 : random() % (word.size() + 1);
+
+        switch (random() % 3) {
+            case 0:
+                word.insert(position, 1, static_cast<char>(character(random)));
+                break;
+            case 1:
+                if (position < word.size()) {
+                    word.erase(position, 1);
+                }
+                break;
+            default:
+                if (position < word.size()) {
+                    word[position] = static_cast<char>(character(random));
+                }
+                break;
+        }
+    }
+
+    return word;
+}
+
+int failures = 0;
+
+void expectEqual(int actual, int expected, const char* what,
+                 const std::string& a, const std::string& b) {
+    if (actual == expected) {
+        return;
+    }
+
+    failures++;
+
+    if (failures <= 10) {
+        std::cerr << what << " returned " << actual << " instead of "
+                  << expected << " for lengths " << a.size() << " and "
+                  << b.size() << "\n";
+    }
+}
+
+void checkPair(const std::string& a, const std::string& b,
+               std::mt19937_64& random) {
+    const int expected = levMatrix(a, b);
+
+    expectEqual(lev(a, b), expected, "lev", a, b);
+    expectEqual(lev(b, a), expected, "lev (swapped)", a, b);
+    expectEqual(LevPattern(a).distance(b), expected, "LevPattern", a, b);
+
+    // exact below the bound, maxDist + 1 above it
+    expectEqual(levBounded(a, b, expected), expected, "levBounded (at bound)",
+                a, b);
+    expectEqual(levBounded(a, b, expected + 1), expected,
+                "levBounded (above bound)", a, b);
+    expectEqual(levBounded(a, b, std::numeric_limits<int>::max()), expected,
+                "levBounded (unbounded)", a, b);
+
+    if (expected > 0) {
+        const int maxDist = static_cast<int>(
+            random() % static_cast<std::uint64_t>(expected));
+
+        expectEqual(levBounded(a, b, maxDist), maxDist + 1,
+                    "levBounded (over bound)", a, b);
+    }
+}
+
+}  // namespace
+
+int main() {
+    std::mt19937_64 random(42);
+
+    for (const auto aLength : edgeLengths) {
+        for (const auto bLength : edgeLengths) {
+            for (const bool smallAlphabet : {true, false}) {
+                checkPair(randomWord(random, aLength, smallAlphabet),
+                          randomWord(random, bLength, smallAlphabet), random);
+            }
+        }
+
+        const std::string word = randomWord(random, aLength, true);
+
+        checkPair(word, word, random);
+        checkPair(word, mutate(random, word, 3), random);
+    }
+
+    std::uniform_int_distribution<std::size_t> length(0, 150);
+
+    for (std::size_t i = 0; i < randomPairs; i++) {
+        const std::string a = randomWord(random, length(random), i % 2 == 0);
+        const std::string b = i % 4 < 2
+                                  ? mutate(random, a, random() % 6)
+                                  : randomWord(random, length(random),
+                                               i % 2 == 0);
+
+        checkPair(a, b, random);
+    }
+
+    if (failures != 0) {
+        std::cerr << failures << " mismatches against levMatrix\n";
+        return 1;
+    }
+
+    std::cout << "lev, levBounded and LevPattern match levMatrix\n";
+    return 0;
+}